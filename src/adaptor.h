@@ -33,5 +33,7 @@
 // The QMetaObject system can't pass a two item template to Q_ARG or Q_RETURN_ARG
 // so it needs to be typedef'ed to compile.
 typedef QMap<windowid_t, QString> WindowNameMap;
+// Needed for TrayItemManager::restoreLatency.
+typedef QMap<QString, uint> RestoreLatencyMap;
 
 #endif // _ADAPTOR
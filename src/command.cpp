@@ -19,7 +19,9 @@
 
 #include "command.h"
 
-Command::Command() : m_type(Command::Type::NoCommand), m_windowId(0), m_pid(0), m_timeout(4), m_checkNormality(true) {}
+Command::Command()
+    : m_type(Command::Type::NoCommand), m_windowId(0), m_pid(0), m_timeout(4), m_checkNormality(true), m_dockAll(false)
+{}
 
 Command::Type Command::getType() const
 {
@@ -61,6 +63,16 @@ quint32 Command::getTimeout() const
     return m_timeout;
 }
 
+QString Command::getManifest() const
+{
+    return m_manifest;
+}
+
+bool Command::getDockAll() const
+{
+    return m_dockAll;
+}
+
 void Command::setType(Command::Type type)
 {
     m_type = type;
@@ -100,3 +112,13 @@ void Command::setCheckNormality(bool v)
 {
     m_checkNormality = v;
 }
+
+void Command::setManifest(const QString &manifest)
+{
+    m_manifest = manifest;
+}
+
+void Command::setDockAll(bool v)
+{
+    m_dockAll = v;
+}
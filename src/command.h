@@ -37,7 +37,8 @@ public:
         Pid,
         Launch,
         Select,
-        Focused
+        Focused,
+        Manifest
     };
 
     Command();
@@ -53,6 +54,8 @@ public:
     QStringList getLaunchAppArguments() const;
     quint32 getTimeout() const;
     bool getCheckNormality() const;
+    QString getManifest() const;
+    bool getDockAll() const;
 
     void setType(Command::Type type);
     void setSearchPattern(const QString &pattern);
@@ -62,6 +65,8 @@ public:
     void setLaunchAppArguments(const QStringList &args);
     void setTimeout(quint32 v);
     void setCheckNormality(bool v);
+    void setManifest(const QString &manifest);
+    void setDockAll(bool v);
 
 private:
     Command::Type m_type;
@@ -72,6 +77,11 @@ private:
     QStringList m_launchAppArguments;
     quint32 m_timeout;
     bool m_checkNormality;
+    // Contents of the manifest file. Read by the client since the running
+    // instance can have a different working directory.
+    QString m_manifest;
+    // Dock every window matching the search pattern now.
+    bool m_dockAll;
 };
 
 Q_DECLARE_METATYPE(Command::Type)
@@ -18,7 +18,9 @@
  */
 
 #include "commandlineargs.h"
+#include "manifest.h"
 
+#include <QFile>
 #include <QRegularExpression>
 #include <QString>
 #include <QStringList>
@@ -35,7 +37,8 @@ bool CommandLineArgs::processArgs(const QStringList &arguments, Command &command
         "2. Specifying a regular expression to find a window based on its title (-n)\n"
         "3. Specifying a window id (-w)\n"
         "4. Specifying a pid (-x)\n"
-        "5. Not specifying any of the above. KDocker will have you select the window to dock. Negated by the -z option\n\n"
+        "5. Specifying a manifest of any number of the above (--manifest)\n"
+        "6. Not specifying any of the above. KDocker will have you select the window to dock. Negated by the -z option\n\n"
         "The -n option is compatible with application launching. Useful if the application spawns another process (E.g. a launcher)");
     parser.addHelpOption();
     parser.addVersionOption();
@@ -44,6 +47,7 @@ bool CommandLineArgs::processArgs(const QStringList &arguments, Command &command
     parser.setOptionsAfterPositionalArgumentsMode(QCommandLineParser::ParseAsPositionalArguments);
 
     parser.addOptions({
+        {{"a", "all"}, "With -n, dock every window that matches now instead of waiting for the first"},
         {{"b", "blind"}, "Suppress the warning dialog when docking non-normal windows (blind mode)"},
         {{"d", "timeout"}, "Maximum time in seconds to allow for a command to start and open a window", "sec", "5"},
         {{"f", "dock-focused"}, "Dock the window that has focus (active window)"},
@@ -54,7 +58,10 @@ bool CommandLineArgs::processArgs(const QStringList &arguments, Command &command
          "file"},
         {{"l", "iconify-focus-lost"}, "Iconify when focus lost"},
         {"m", "Don't iconfiy when minimized"},
-        {{"n", "search-pattern"}, "Match window based on its name (title) using a PCRE regular expression", "pattern"},
+        {{"n", "search-pattern"},
+         "Match window based on its name (title) using a PCRE regular expression or a match expression such as "
+         "'class=firefox && title~Inbox'",
+         "pattern"},
         {{"o", "iconify-obscured"}, "Iconify when obscured by other windows"},
         {{"p", "notify-time"},
          "Maximum time in seconds to display a notification when window title changes",
@@ -65,6 +72,9 @@ bool CommandLineArgs::processArgs(const QStringList &arguments, Command &command
         {{"s", "sticky"}, "Make the window sticky (appears on all desktops)"},
         {{"t", "skip-taskbar"}, "Remove this application from the taskbar"},
         {"no-iconify-docking", "Don't iconify the window when docking"},
+        {"hide-strategy", "How the window is hidden when iconified: withdraw (default), iconic or unmap",
+         "strategy"},
+        {"manifest", "JSON file listing apps to launch and windows to dock. See the README for the format", "file"},
         // Don't use v or version because they're already handled by the parser object.
         {{"w", "window-id"}, "Window id of the application to dock. Hex number formatted (0x###...)", "window-id"},
         {{"x", "pid"}, "Process id of the application to dock. Decimal number (###...)", "pid"},
@@ -78,6 +88,8 @@ bool CommandLineArgs::processArgs(const QStringList &arguments, Command &command
 
     buildConfig(parser, config);
     buildCommand(parser, command);
+    if (command.getType() == Command::Type::Manifest && !loadManifest(parser.value("manifest"), command))
+        return false;
 
     keepRunning = false;
     if (parser.isSet("keep-running"))
@@ -96,8 +108,15 @@ bool CommandLineArgs::validateParserArgs(const QCommandLineParser &parser)
         num_dock_requests++;
     if (parser.positionalArguments().size() > 0)
         num_dock_requests++;
+    if (parser.isSet("manifest"))
+        num_dock_requests++;
     if (num_dock_requests > 1) {
-        qCritical() << "Only one of, -w, -x, or application can be specified";
+        qCritical() << "Only one of, -w, -x, --manifest, or application can be specified";
+        return false;
+    }
+    // Every manifest entry has its own pattern.
+    if (parser.isSet("manifest") && parser.isSet("search-pattern")) {
+        qCritical() << "Only one of, -n or --manifest can be specified";
         return false;
     }
 
@@ -111,6 +130,18 @@ bool CommandLineArgs::validateParserArgs(const QCommandLineParser &parser)
         }
     }
 
+    // Only windows that already exist can all be docked.
+    if (parser.isSet("all") && (!parser.isSet("search-pattern") || num_dock_requests > 0)) {
+        qCritical() << "-a can only be used with -n";
+        return false;
+    }
+
+    if (parser.isSet("hide-strategy") &&
+        TrayItemOptions::hideStrategyFromName(parser.value("hide-strategy")) == TrayItemOptions::HideStrategy::Unset) {
+        qCritical() << "Unknown hide strategy" << parser.value("hide-strategy");
+        return false;
+    }
+
     // Verify the pid is a valid number
     if (parser.isSet("pid")) {
         bool ok;
@@ -160,6 +191,9 @@ void CommandLineArgs::buildConfig(const QCommandLineParser &parser, TrayItemOpti
 
     if (parser.isSet("no-iconify-docking"))
         config.setIconifyDocking(TrayItemOptions::TriState::SetFalse);
+
+    if (parser.isSet("hide-strategy"))
+        config.setHideStrategy(TrayItemOptions::hideStrategyFromName(parser.value("hide-strategy")));
 }
 
 void CommandLineArgs::buildCommand(const QCommandLineParser &parser, Command &command)
@@ -169,6 +203,7 @@ void CommandLineArgs::buildCommand(const QCommandLineParser &parser, Command &co
     if (parser.isSet("search-pattern")) {
         command.setType(Command::Type::Title);
         command.setSearchPattern(parser.value("search-pattern"));
+        command.setDockAll(parser.isSet("all"));
     }
 
     // Timeout can be used by search pattern and launch
@@ -201,6 +236,8 @@ void CommandLineArgs::buildCommand(const QCommandLineParser &parser, Command &co
         command.setType(Command::Type::Launch);
         command.setLaunchApp(parser.positionalArguments().at(0));
         command.setLaunchAppArguments(parser.positionalArguments().sliced(1));
+    } else if (parser.isSet("manifest")) {
+        command.setType(Command::Type::Manifest);
     } else if (parser.isSet("dock-focused")) {
         command.setType(Command::Type::Focused);
     }
@@ -209,3 +246,23 @@ void CommandLineArgs::buildCommand(const QCommandLineParser &parser, Command &co
     if (command.getType() == Command::Type::NoCommand)
         command.setType(Command::Type::Select);
 }
+
+bool CommandLineArgs::loadManifest(const QString &path, Command &command)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Could not read manifest" << path << file.errorString();
+        return false;
+    }
+
+    QByteArray json = file.readAll();
+    Manifest manifest;
+    QString error;
+    if (!Manifest::parse(json, &manifest, &error)) {
+        qCritical() << "Invalid manifest" << path << error;
+        return false;
+    }
+
+    command.setManifest(QString::fromUtf8(json));
+    return true;
+}
@@ -34,6 +34,8 @@ private:
     static bool validateParserArgs(const QCommandLineParser &parser);
     static void buildConfig(const QCommandLineParser &parser, TrayItemOptions &config);
     static void buildCommand(const QCommandLineParser &parser, Command &command);
+    // Reads and checks the manifest so errors are shown by the client.
+    static bool loadManifest(const QString &path, Command &command);
 };
 
 #endif // _COMMANDLINEARGS_H
@@ -18,61 +18,119 @@
  */
 
 #include "grabinfo.h"
+#include "xlibutil.h"
 
-GrabInfo::GrabInfo() : m_window(0), m_button(0), m_isGrabbing(false)
+// X11 Button1.
+static const unsigned int LEFT_BUTTON = 1;
+
+GrabInfo::GrabInfo() : m_startQueued(false), m_callbackQueued(false), m_inCallback(false)
 {
-    connect(&m_qtimer, &QTimer::timeout, &m_qloop, &QEventLoop::quit);
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, [this] { finish(0); });
 }
 
-void GrabInfo::exec()
+GrabInfo::~GrabInfo()
 {
-    m_window = 0;
-    m_button = 0;
-    m_isGrabbing = true; // Enable XCB_BUTTON_PRESS code in event filter
-                         //
-    m_qtimer.setSingleShot(true);
-    m_qtimer.start(6000); // 6 second timeout
-
-    m_qloop.exec(); // block until button pressed or timeout
+    XLibUtil::ungrabSelection(m_grab);
 }
 
-void GrabInfo::stop()
+void GrabInfo::select(int timeout, Callback callback)
 {
-    m_isGrabbing = false;
-    m_qloop.quit();
+    m_requests.append({timeout > 0 ? timeout : DEFAULT_TIMEOUT, std::move(callback)});
+
+    // Started from the event loop so the caller never sees the callback
+    // before select returns.
+    if (!m_grab.active && !m_startQueued) {
+        m_startQueued = true;
+        QMetaObject::invokeMethod(this, &GrabInfo::startNext, Qt::QueuedConnection);
+    }
 }
 
-void GrabInfo::stopGrabbing()
+void GrabInfo::cancelAll()
 {
-    m_isGrabbing = false;
+    QList<Request> requests;
+    requests.swap(m_requests);
+    m_timer.stop();
+    XLibUtil::ungrabSelection(m_grab);
+
+    for (const Request &request : std::as_const(requests)) {
+        request.callback(0, QString());
+    }
 }
 
-bool GrabInfo::isGrabbing()
+bool GrabInfo::isGrabbing() const
 {
-    return m_isGrabbing;
+    return m_grab.active;
 }
 
-bool GrabInfo::isActive()
+qsizetype GrabInfo::pending() const
 {
-    return m_qtimer.isActive();
+    return m_requests.size() + (m_callbackQueued ? 1 : 0);
 }
 
-windowid_t GrabInfo::getWindow()
+bool GrabInfo::buttonPressed(unsigned int button, windowid_t child)
 {
-    return m_window;
+    if (!m_grab.active)
+        return false;
+
+    // Any other button cancels. A click on the root window selects nothing.
+    windowid_t window = 0;
+    if (button == LEFT_BUTTON && child != 0)
+        window = XLibUtil::getClientWindow(child);
+    finish(window);
+    return true;
 }
 
-unsigned int GrabInfo::getButton()
+bool GrabInfo::keyReleased(unsigned int key)
 {
-    return m_button;
+    if (!m_grab.active || key != m_grab.escapeKey)
+        return false;
+
+    finish(0);
+    return true;
 }
 
-void GrabInfo::setWindow(windowid_t window)
+void GrabInfo::startNext()
 {
-    m_window = window;
+    m_startQueued = false;
+    // runCallback starts the next one once the callback returns.
+    if (m_grab.active || m_callbackQueued || m_inCallback || m_requests.isEmpty())
+        return;
+
+    QString error;
+    if (!XLibUtil::grabSelection(m_grab, error)) {
+        finish(0, error);
+        return;
+    }
+    m_timer.start(m_requests.first().timeout);
 }
 
-void GrabInfo::setButton(unsigned int button)
+void GrabInfo::finish(windowid_t window, const QString &error)
 {
-    m_button = button;
+    m_timer.stop();
+    XLibUtil::ungrabSelection(m_grab);
+    if (m_requests.isEmpty())
+        return;
+
+    // finish is called from the native event filter. The callback can dock a
+    // window or show a dialog so it runs from the event loop instead.
+    Request request = m_requests.takeFirst();
+    m_callbackQueued = true;
+    QMetaObject::invokeMethod(
+        this, [this, request, window, error] { runCallback(request, window, error); }, Qt::QueuedConnection);
+}
+
+void GrabInfo::runCallback(const Request &request, windowid_t window, const QString &error)
+{
+    // The callback can show dialogs which run their own event loop. The
+    // next selection isn't started until it returns.
+    m_callbackQueued = false;
+    m_inCallback = true;
+    request.callback(window, error);
+    m_inCallback = false;
+
+    if (!m_requests.isEmpty() && !m_grab.active && !m_startQueued) {
+        m_startQueued = true;
+        QMetaObject::invokeMethod(this, &GrabInfo::startNext, Qt::QueuedConnection);
+    }
 }
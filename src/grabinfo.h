@@ -20,70 +20,73 @@
 #ifndef _GRABINFO_H
 #define _GRABINFO_H
 
-#include <QEventLoop>
+#include <QList>
 #include <QObject>
+#include <QString>
 #include <QTimer>
 
+#include <functional>
+
 #include "xlibtypes.h"
 
-// This is used in a very bad and strange design that really needs to be replaced.
-//
-// TrayItemManager::userSelectWindow passes a GrabInfo object to XLibUtil::selectWindow.
-// XLibUtil::selectWindow calls GrabInfo::exec which is blocking. Blocking happens by
-// running an event loop that does nothing but block execution (m_qloop). Exection resumes
-// when one of the following happens:
-//
-// 1. A timeout timer (m_qtimer) that starts when exec is called times out.
-// 2. The native event filter receives an event of key press ESC (our cancel key).
-// 3. The native event filter receives a button press event (mouse click).
-//
-// Number 1 just stops the event loop and resumes execution of
-// XLibUtil::selectWindow. No window will have been stored in GrabInfo so no
-// window is returned.
-//
-// Number 2 tells the GrabInfo object to stop the event loop and resumes
-// execution of XLibUtil::selectWindow. No window will have been stored in
-// GrabInfo so no window is returned.
+// Lets the user select a window with the mouse without blocking.
 //
-// Number 3 will set the button click and the selected window (if there was
-// one) in GrabInfo. Then it will tell the GrabInfo object to stop the event
-// loop and resumes execution of XLibUtil::selectWindow. The button will
-// be verified to a left mouse click, the window will be verified and if this
-// all passes validation, the selected window will be docked.
+// select returns right away. The mouse and Escape key are grabbed and the
+// native event filter passes the button press or key release here. The
+// callback is called once the user clicks, cancels, or the timeout passes.
+// Everything else, DBus calls included, keeps being handled in the
+// meantime.
 //
-// Essentially, we're going to use an object to broker data while also using it to
-// block in a function while waiting for events that change the broker object
-// and tell it when to stop blocking.
-
+// Only one grab can be active at a time. Selections requested while one is
+// running wait their turn.
 class GrabInfo : public QObject
 {
     Q_OBJECT
 
 public:
-    GrabInfo();
+    // window is 0 when nothing was selected. error is set when the grab failed.
+    using Callback = std::function<void(windowid_t window, const QString &error)>;
 
-    void exec();
+    static const int DEFAULT_TIMEOUT = 6000;
 
-    bool isGrabbing();
-    bool isActive();
-    windowid_t getWindow();
-    unsigned int getButton();
+    GrabInfo();
+    ~GrabInfo();
 
-    void setWindow(windowid_t window);
-    void setButton(unsigned int button);
+    // timeout is in milliseconds.
+    void select(int timeout, Callback callback);
+    // Cancels the running selection and all waiting ones.
+    void cancelAll();
 
-    void stopGrabbing();
+    bool isGrabbing() const;
+    // Selections running or waiting.
+    qsizetype pending() const;
 
-public slots:
-    void stop();
+    // Native event filter. Return true if the event was for the grab.
+    bool buttonPressed(unsigned int button, windowid_t child);
+    bool keyReleased(unsigned int key);
 
 private:
-    QTimer m_qtimer;
-    QEventLoop m_qloop;
+    struct Request
+    {
+        int timeout;
+        Callback callback;
+    };
+
+    void startNext();
+    // Ends the running selection. Its callback is queued.
+    void finish(windowid_t window, const QString &error = QString());
+    void runCallback(const Request &request, windowid_t window, const QString &error);
 
-    windowid_t m_window;
-    unsigned int m_button;
-    bool m_isGrabbing;
+    // The first is the running selection once the grab is made.
+    QList<Request> m_requests;
+    QTimer m_timer;
+    XLibUtilGrab m_grab;
+    // A call to startNext is waiting in the event loop.
+    bool m_startQueued;
+    // A finished selection's callback is waiting in the event loop.
+    bool m_callbackQueued;
+    // A callback is running. It can run a nested event loop for a dialog.
+    bool m_inCallback;
 };
 
 #endif // _GRABINFO_H
@@ -0,0 +1,214 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "launcher.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// posix_spawn_file_actions_addchdir_np. __GLIBC_PREREQ only exists with glibc.
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 29)
+#define HAVE_SPAWN_ADDCHDIR
+#endif
+#endif
+
+// How often children are checked when they can't be watched with a pidfd.
+static const int POLL_INTERVAL = 1000;
+
+// Arguments and environment for posix_spawn. The strings are owned by the
+// list they're built from.
+static QList<char *> toArgv(QList<QByteArray> &strings)
+{
+    QList<char *> argv;
+    for (QByteArray &string : strings) {
+        argv.append(string.data());
+    }
+    argv.append(nullptr);
+    return argv;
+}
+
+Launcher::Launcher(int maxPending) : m_maxPending(maxPending), m_nextId(0), m_startQueued(false)
+{
+    m_pollTimer.setInterval(POLL_INTERVAL);
+    connect(&m_pollTimer, &QTimer::timeout, this, &Launcher::pollChildren);
+}
+
+quint64 Launcher::launch(const LaunchRequest &request)
+{
+    quint64 id = ++m_nextId;
+    m_queue.append(qMakePair(id, request));
+    queueStart();
+    return id;
+}
+
+void Launcher::settle(quint64 id)
+{
+    if (m_pending.remove(id))
+        queueStart();
+}
+
+void Launcher::setMaxPending(int maxPending)
+{
+    m_maxPending = qMax(1, maxPending);
+    // A higher limit lets queued launches start now.
+    queueStart();
+}
+
+void Launcher::queueStart()
+{
+    // Started from the event loop so signals are never emitted before
+    // launch returns.
+    if (m_startQueued || m_queue.isEmpty())
+        return;
+    m_startQueued = true;
+    QMetaObject::invokeMethod(this, &Launcher::startNext, Qt::QueuedConnection);
+}
+
+void Launcher::startNext()
+{
+    m_startQueued = false;
+    while (!m_queue.isEmpty() && m_pending.size() < m_maxPending) {
+        QPair<quint64, LaunchRequest> next = m_queue.takeFirst();
+
+        QString error;
+        pid_t pid = spawn(next.second, &error);
+        if (pid == -1) {
+            emit failed(next.first, error);
+            continue;
+        }
+
+        m_pending.insert(next.first);
+        watch(pid);
+        emit started(next.first, pid);
+    }
+}
+
+pid_t Launcher::spawn(const LaunchRequest &request, QString *error)
+{
+    QByteArray program = QFile::encodeName(request.program);
+    QList<QByteArray> arguments = {program};
+    for (const QString &argument : request.arguments) {
+        arguments.append(argument.toLocal8Bit());
+    }
+    QList<QByteArray> environment;
+    QProcessEnvironment processEnvironment =
+        request.environment.isEmpty() ? QProcessEnvironment::systemEnvironment() : request.environment;
+    for (const QString &variable : processEnvironment.toStringList()) {
+        environment.append(variable.toLocal8Bit());
+    }
+    QList<char *> argv = toArgv(arguments);
+    QList<char *> envp = toArgv(environment);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    QByteArray output = QFile::encodeName(request.outputFile);
+    if (!output.isEmpty()) {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output.constData(), O_WRONLY | O_CREAT | O_APPEND,
+                                         0644);
+        posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    }
+    QByteArray directory = QFile::encodeName(request.workingDirectory);
+    if (!directory.isEmpty()) {
+#ifdef HAVE_SPAWN_ADDCHDIR
+        posix_spawn_file_actions_addchdir_np(&actions, directory.constData());
+#else
+        posix_spawn_file_actions_destroy(&actions);
+        *error = tr("Setting the working directory isn't supported on this system");
+        return -1;
+#endif
+    }
+
+    // Signals KDocker handles or ignores go back to their defaults. SIGKILL
+    // and SIGSTOP can't be changed.
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attributes, &mask);
+    sigset_t defaults;
+    sigfillset(&defaults);
+    sigdelset(&defaults, SIGKILL);
+    sigdelset(&defaults, SIGSTOP);
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+    // Closing the terminal KDocker was started from doesn't close the app.
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attributes, flags);
+
+    pid_t pid = -1;
+    int ret = posix_spawnp(&pid, program.constData(), &actions, &attributes, argv.data(), envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if (ret != 0) {
+        *error = QString::fromLocal8Bit(strerror(ret));
+        return -1;
+    }
+    return pid;
+}
+
+void Launcher::watch(pid_t pid)
+{
+    PidWatcher *watcher = new PidWatcher(pid);
+    if (!watcher->isWatching()) {
+        delete watcher;
+        m_children.insert(pid, nullptr);
+        m_pollTimer.start();
+        return;
+    }
+
+    watcher->setParent(this);
+    connect(watcher, &PidWatcher::exited, this, &Launcher::reap);
+    m_children.insert(pid, watcher);
+}
+
+void Launcher::reap(pid_t pid)
+{
+    int status = 0;
+    if (waitpid(pid, &status, WNOHANG) != pid)
+        return;
+
+    PidWatcher *watcher = m_children.take(pid);
+    if (watcher != nullptr)
+        watcher->deleteLater();
+    emit exited(pid, status);
+}
+
+void Launcher::pollChildren()
+{
+    bool polled = false;
+    for (pid_t pid : m_children.keys()) {
+        if (m_children.value(pid) != nullptr)
+            continue;
+        polled = true;
+        reap(pid);
+    }
+    if (!polled)
+        m_pollTimer.stop();
+}
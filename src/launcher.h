@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _LAUNCHER_H
+#define _LAUNCHER_H
+
+#include "pidwatcher.h"
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QProcessEnvironment>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include <sys/types.h>
+
+struct LaunchRequest
+{
+    QString program;
+    QStringList arguments;
+    // Empty uses KDocker's environment.
+    QProcessEnvironment environment;
+    // Empty uses KDocker's working directory.
+    QString workingDirectory;
+    // stdout and stderr are appended to this file. Empty shares KDocker's.
+    QString outputFile;
+};
+
+// Starts applications with posix_spawn and reaps them when they exit.
+//
+// Launches are queued. At most maxPending are started and not yet settled.
+// The rest wait so logging in with many docked apps doesn't start them all
+// at once. A launch is settled by the caller once it's done with it, such
+// as when its window has been found.
+//
+// Applications are started in their own session with default signal
+// handling and stdin from /dev/null, the same as a detached QProcess.
+class Launcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int DEFAULT_MAX_PENDING = 4;
+
+    explicit Launcher(int maxPending = DEFAULT_MAX_PENDING);
+
+    // Returns an id passed to started or failed. One of them is emitted from
+    // the event loop once it's the launch's turn.
+    quint64 launch(const LaunchRequest &request);
+    // Lets the next queued launch start.
+    void settle(quint64 id);
+    // Takes effect for launches that haven't started yet. At least 1.
+    void setMaxPending(int maxPending);
+
+signals:
+    void started(quint64 id, pid_t pid);
+    void failed(quint64 id, const QString &error);
+    // A launched process exited and was reaped. status is from waitpid.
+    void exited(pid_t pid, int status);
+
+private:
+    void queueStart();
+    void startNext();
+    pid_t spawn(const LaunchRequest &request, QString *error);
+    void watch(pid_t pid);
+    void reap(pid_t pid);
+    // Only used for children without a pidfd.
+    void pollChildren();
+
+    int m_maxPending;
+    quint64 m_nextId;
+    QList<QPair<quint64, LaunchRequest>> m_queue;
+    // Started and not settled.
+    QSet<quint64> m_pending;
+    bool m_startQueued;
+    // Children that haven't been reaped. The watcher is null without pidfd.
+    QHash<pid_t, PidWatcher *> m_children;
+    QTimer m_pollTimer;
+};
+
+#endif // _LAUNCHER_H
@@ -34,6 +34,9 @@
 #include <QDBusReply>
 #include <QLocale>
 #include <QObject>
+#include <QTextStream>
+
+#include <limits>
 
 #include <signal.h>
 
@@ -59,7 +62,9 @@ static bool setupDbus(TrayItemManager *trayitemmanager)
     return registered;
 }
 
-static void sendDbusCommand(const Command &command, const TrayItemOptions &config, bool keepRunning)
+// instance is set when this is the running instance.
+static void sendDbusCommand(const Command &command, const TrayItemOptions &config, bool keepRunning,
+                            TrayItemManager *instance)
 {
     QDBusInterface iface(Constants::DBUS_NAME, Constants::DBUS_PATH);
     if (!iface.isValid()) {
@@ -75,6 +80,11 @@ static void sendDbusCommand(const Command &command, const TrayItemOptions &confi
         case Command::Type::NoCommand:
             break;
         case Command::Type::Title:
+            if (command.getDockAll()) {
+                iface.call(QDBus::NoBlock, "dockWindowTitle", command.getSearchPattern(), command.getCheckNormality(),
+                           true, QVariant::fromValue(config));
+                break;
+            }
             iface.call(QDBus::NoBlock, "dockWindowTitle", command.getSearchPattern(), command.getTimeout(),
                        command.getCheckNormality(), QVariant::fromValue(config));
             break;
@@ -99,6 +109,27 @@ static void sendDbusCommand(const Command &command, const TrayItemOptions &confi
         case Command::Type::Focused:
             iface.call(QDBus::NoBlock, "dockFocused", QVariant::fromValue(config));
             break;
+        case Command::Type::Manifest: {
+            // A call to ourselves can't wait for the report. It's printed by
+            // the manager instead. Queued so it runs from the event loop like
+            // a DBus call and can quit the application.
+            if (instance != nullptr) {
+                QString manifest = command.getManifest();
+                QMetaObject::invokeMethod(
+                    instance, [instance, manifest] { instance->dockManifest(manifest); }, Qt::QueuedConnection);
+                break;
+            }
+            // The reply comes once every entry has finished. Launches can
+            // wait their turn so there's no useful limit.
+            iface.setTimeout(std::numeric_limits<int>::max());
+            QDBusReply<QString> reply = iface.call("dockManifest", command.getManifest());
+            if (!reply.isValid()) {
+                qCritical().noquote() << reply.error().message();
+                ::exit(1);
+            }
+            QTextStream(stdout) << reply.value();
+            break;
+        }
         default:
             qFatal("COMMAND ERROR!!!!");
     }
@@ -107,9 +138,11 @@ static void sendDbusCommand(const Command &command, const TrayItemOptions &confi
 static void registerTypes()
 {
     qRegisterMetaType<WindowNameMap>("WindowNameMap");
+    qRegisterMetaType<RestoreLatencyMap>("RestoreLatencyMap");
     qRegisterMetaType<TrayItemOptions>("TrayItemOptions");
     qDBusRegisterMetaType<TrayItemOptions>();
     qDBusRegisterMetaType<WindowNameMap>();
+    qDBusRegisterMetaType<RestoreLatencyMap>();
 }
 
 int main(int argc, char *argv[])
@@ -117,7 +150,7 @@ int main(int argc, char *argv[])
     // Register all our meta types so they're available
     registerTypes();
 
-    XLibUtil::silenceXErrors();
+    XLibUtil::installErrorHandler();
 
     Application app(argc, argv);
 
@@ -150,7 +183,7 @@ int main(int argc, char *argv[])
     // Setup Dbus so we'll only have 1 instance running
     bool dbus_registered = setupDbus(&trayItemManager);
     // Send the requested action through DBus regardless if this is the only instance.
-    sendDbusCommand(command, config, keepRunning);
+    sendDbusCommand(command, config, keepRunning, dbus_registered ? &trayItemManager : nullptr);
 
     // Can't register dbus means another instance already has. Requests
     // were handled by the other instance and there is nothing more for us to do.
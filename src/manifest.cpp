@@ -0,0 +1,149 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "manifest.h"
+#include "matchexpression.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QObject>
+
+QString ManifestEntry::label() const
+{
+    switch (type) {
+        case Type::Launch:
+            return command;
+        case Type::Title:
+            return pattern;
+        case Type::Pid:
+            return QString("pid %1").arg(pid);
+    }
+    return QString();
+}
+
+// Checked here so a bad pattern fails the whole manifest before anything is
+// launched, instead of being reported by the scanner later.
+static bool checkPattern(const QString &pattern, QString *error)
+{
+    MatchExpression expression(pattern);
+    if (!expression.isValid()) {
+        *error = QObject::tr("invalid pattern '%1': %2").arg(pattern).arg(expression.errorString());
+        return false;
+    }
+    return true;
+}
+
+static bool parseEntry(const QJsonObject &object, ManifestEntry *entry, QString *error)
+{
+    if (object.contains("launch")) {
+        entry->type = ManifestEntry::Type::Launch;
+        entry->command = object.value("launch").toString();
+        if (entry->command.isEmpty()) {
+            *error = QObject::tr("launch is empty");
+            return false;
+        }
+        for (const QJsonValue &argument : object.value("args").toArray()) {
+            entry->arguments.append(argument.toString());
+        }
+        entry->pattern = object.value("pattern").toString();
+        if (!entry->pattern.isEmpty() && !checkPattern(entry->pattern, error))
+            return false;
+        entry->workingDirectory = object.value("cwd").toString();
+        entry->outputFile = object.value("output").toString();
+        const QJsonObject environment = object.value("env").toObject();
+        for (auto it = environment.begin(); it != environment.end(); ++it) {
+            if (!it.value().isString()) {
+                *error = QObject::tr("env value of '%1' must be a string").arg(it.key());
+                return false;
+            }
+            entry->environment.insert(it.key(), it.value().toString());
+        }
+    } else if (object.contains("title")) {
+        entry->type = ManifestEntry::Type::Title;
+        entry->pattern = object.value("title").toString();
+        if (entry->pattern.isEmpty()) {
+            *error = QObject::tr("title is empty");
+            return false;
+        }
+        if (!checkPattern(entry->pattern, error))
+            return false;
+    } else if (object.contains("pid")) {
+        entry->type = ManifestEntry::Type::Pid;
+        entry->pid = static_cast<pid_t>(object.value("pid").toInt());
+        if (entry->pid <= 0) {
+            *error = QObject::tr("pid must be a positive number");
+            return false;
+        }
+    } else {
+        *error = QObject::tr("needs one of launch, title or pid");
+        return false;
+    }
+
+    // Same limits as the command line.
+    int timeout = object.value("timeout").toInt(entry->timeout);
+    entry->timeout = static_cast<quint32>(qBound(1, timeout, 100));
+    entry->checkNormality = object.value("checkNormality").toBool(true);
+
+    const QJsonObject options = object.value("options").toObject();
+    for (auto it = options.begin(); it != options.end(); ++it) {
+        // JSON booleans and numbers are accepted as well as strings.
+        QString value = it.value().isString() ? it.value().toString() : it.value().toVariant().toString();
+        if (!entry->options.setOption(it.key(), value)) {
+            *error = QObject::tr("unknown option '%1'").arg(it.key());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Manifest::parse(const QByteArray &json, Manifest *manifest, QString *error)
+{
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(json, &parseError);
+    if (document.isNull()) {
+        *error = parseError.errorString();
+        return false;
+    }
+    if (!document.isObject() || !document.object().value("entries").isArray()) {
+        *error = QObject::tr("Expected an object with an entries array");
+        return false;
+    }
+
+    const QJsonObject root = document.object();
+    manifest->concurrency = qMax(0, root.value("concurrency").toInt(0));
+    const QJsonArray entries = root.value("entries").toArray();
+    if (entries.isEmpty()) {
+        *error = QObject::tr("No entries");
+        return false;
+    }
+    for (qsizetype i = 0; i < entries.size(); i++) {
+        ManifestEntry entry;
+        QString entryError;
+        if (!entries[i].isObject() || !parseEntry(entries[i].toObject(), &entry, &entryError)) {
+            if (entryError.isEmpty())
+                entryError = QObject::tr("not an object");
+            *error = QObject::tr("Entry %1: %2").arg(i + 1).arg(entryError);
+            return false;
+        }
+        manifest->entries.append(entry);
+    }
+    return true;
+}
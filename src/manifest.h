@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _MANIFEST_H
+#define _MANIFEST_H
+
+#include "trayitemoptions.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+#include <sys/types.h>
+
+// Many dock requests in one JSON document so a session can dock all its
+// apps with one call:
+//
+//   {
+//     "concurrency": 4,
+//     "entries": [
+//       { "launch": "thunderbird", "args": [], "pattern": "", "timeout": 10,
+//         "cwd": "/home/user", "output": "/tmp/thunderbird.log", "env": { "LANG": "C" },
+//         "options": { "iconify-focus-lost": "true" } },
+//       { "title": "class=firefox" },
+//       { "pid": 1234, "checkNormality": false }
+//     ]
+//   }
+//
+// There must be at least one entry. Each has one of launch, title or pid.
+// pattern, cwd, output and env are only used with launch. output gets the
+// app's stdout and stderr appended. env is added to KDocker's environment. timeout is in seconds. options takes the
+// windowConfig keys.
+struct ManifestEntry
+{
+    enum class Type
+    {
+        Launch,
+        Title,
+        Pid
+    };
+
+    Type type = Type::Launch;
+    QString command;
+    QStringList arguments;
+    // The search pattern for Title, or the optional one for Launch.
+    QString pattern;
+    // Launch only. Empty uses KDocker's.
+    QString workingDirectory;
+    QString outputFile;
+    // Launch only. Set on top of KDocker's environment.
+    QMap<QString, QString> environment;
+    pid_t pid = 0;
+    quint32 timeout = 5;
+    bool checkNormality = true;
+    TrayItemOptions options;
+
+    // Identifies the entry in messages.
+    QString label() const;
+};
+
+struct Manifest
+{
+    // Launches started at once. 0 leaves the launcher's limit.
+    int concurrency = 0;
+    QList<ManifestEntry> entries;
+
+    // Returns false and sets error if the document isn't a valid manifest.
+    static bool parse(const QByteArray &json, Manifest *manifest, QString *error);
+};
+
+#endif // _MANIFEST_H
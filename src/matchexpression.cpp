@@ -0,0 +1,337 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "matchexpression.h"
+
+#include <QObject>
+#include <QRegularExpression>
+
+
+// Characters that end an unquoted value.
+static bool isValueEnd(QChar c)
+{
+    return c.isSpace() || c == '(' || c == ')' || c == '&' || c == '|' || c == '!' || c == '"';
+}
+
+MatchExpression::MatchExpression() : m_root(-1), m_fields(0), m_pos(0) {}
+
+MatchExpression::MatchExpression(const QString &pattern) : m_pattern(pattern), m_root(-1), m_fields(0), m_pos(0)
+{
+    if (!isExpression(pattern)) {
+        QRegularExpression regex(pattern);
+        if (!regex.isValid()) {
+            m_error = regex.errorString();
+            return;
+        }
+        m_root = addNode({NodeType::Legacy, Property::None, -1, -1, QByteArray(), 0, WindowMatcher(regex)});
+        m_fields = XLibUtilWindowInfo::Class | XLibUtilWindowInfo::Name;
+        return;
+    }
+
+    m_root = parseOr();
+    skipSpace();
+    if (m_root != -1 && m_pos < m_pattern.size())
+        m_root = fail(QObject::tr("Unexpected '%1'").arg(m_pattern.mid(m_pos, 1)));
+    if (m_root == -1)
+        m_nodes.clear();
+}
+
+bool MatchExpression::isExpression(const QString &pattern)
+{
+    static const QRegularExpression start("^\\s*[!(\\s]*(class|instance|title|role|pid)\\s*(=|!=|~|!~)");
+    return start.match(pattern).hasMatch();
+}
+
+const QString &MatchExpression::pattern() const
+{
+    return m_pattern;
+}
+
+bool MatchExpression::isValid() const
+{
+    return m_root != -1;
+}
+
+QString MatchExpression::errorString() const
+{
+    return m_error;
+}
+
+quint32 MatchExpression::fields() const
+{
+    return m_fields;
+}
+
+bool MatchExpression::matches(const XLibUtilWindowInfo &info) const
+{
+    if (m_root == -1)
+        return false;
+    return evaluate(m_root, info);
+}
+
+bool MatchExpression::evaluate(int index, const XLibUtilWindowInfo &info) const
+{
+    const Node &node = m_nodes[index];
+    switch (node.type) {
+        case NodeType::And:
+            return evaluate(node.left, info) && evaluate(node.right, info);
+        case NodeType::Or:
+            return evaluate(node.left, info) || evaluate(node.right, info);
+        case NodeType::Not:
+            return !evaluate(node.left, info);
+        case NodeType::Legacy:
+            // Can't analyze windows without a name
+            if (!info.hasName || !info.hasClass)
+                return false;
+
+            // Checking res_name first because it is the window title and for
+            // something like a text editor could show the document name or
+            // something like "unsaved". This allows for the user to more
+            // robustly match if there are multiple windows they're trying
+            // to differentiate multiple windows of the same application.
+            //
+            // Fall back to res_class which is the application name.
+            if (!info.resNameUtf8.isEmpty() && node.matcher.matches(info.resNameUtf8, info.resName))
+                return true;
+            if (!info.resClassUtf8.isEmpty() && node.matcher.matches(info.resClassUtf8, info.resClass))
+                return true;
+            // sheer desperation
+            return node.matcher.matches(info.nameUtf8, info.name);
+        case NodeType::Equals:
+        case NodeType::Matches:
+            break;
+    }
+
+    const QByteArray *utf8 = nullptr;
+    const QString *text = nullptr;
+    switch (node.property) {
+        case Property::Class:
+            utf8 = &info.resClassUtf8;
+            text = &info.resClass;
+            break;
+        case Property::Instance:
+            utf8 = &info.resNameUtf8;
+            text = &info.resName;
+            break;
+        case Property::Title:
+            utf8 = &info.titleUtf8;
+            text = &info.title;
+            break;
+        case Property::Role:
+            utf8 = &info.roleUtf8;
+            text = &info.role;
+            break;
+        case Property::Pid:
+            return info.pid == node.pid;
+        case Property::None:
+            return false;
+    }
+
+    if (node.type == NodeType::Equals)
+        return *utf8 == node.value;
+    return node.matcher.matches(*utf8, *text);
+}
+
+int MatchExpression::parseOr()
+{
+    int left = parseAnd();
+    while (left != -1) {
+        skipSpace();
+        if (!consume("||"))
+            break;
+        int right = parseAnd();
+        if (right == -1)
+            return -1;
+        left = addNode(NodeType::Or, left, right);
+    }
+    return left;
+}
+
+int MatchExpression::parseAnd()
+{
+    int left = parseUnary();
+    while (left != -1) {
+        skipSpace();
+        if (!consume("&&"))
+            break;
+        int right = parseUnary();
+        if (right == -1)
+            return -1;
+        left = addNode(NodeType::And, left, right);
+    }
+    return left;
+}
+
+int MatchExpression::parseUnary()
+{
+    skipSpace();
+    if (consume("!")) {
+        int operand = parseUnary();
+        if (operand == -1)
+            return -1;
+        return addNode(NodeType::Not, operand, -1);
+    }
+
+    if (consume("(")) {
+        int inner = parseOr();
+        if (inner == -1)
+            return -1;
+        skipSpace();
+        if (!consume(")"))
+            return fail(QObject::tr("Missing ')'"));
+        return inner;
+    }
+
+    return parseComparison();
+}
+
+int MatchExpression::parseComparison()
+{
+    int start = m_pos;
+    while (m_pos < m_pattern.size() && m_pattern[m_pos].isLetter()) {
+        m_pos++;
+    }
+    QString name = m_pattern.mid(start, m_pos - start);
+    if (name.isEmpty())
+        return fail(QObject::tr("Expected a field"));
+
+    Node node{NodeType::Equals, Property::None, -1, -1, QByteArray(), 0, WindowMatcher()};
+    quint32 field = 0;
+    if (name == "class") {
+        node.property = Property::Class;
+        field = XLibUtilWindowInfo::Class;
+    } else if (name == "instance") {
+        node.property = Property::Instance;
+        field = XLibUtilWindowInfo::Class;
+    } else if (name == "title") {
+        node.property = Property::Title;
+        field = XLibUtilWindowInfo::Title;
+    } else if (name == "role") {
+        node.property = Property::Role;
+        field = XLibUtilWindowInfo::Role;
+    } else if (name == "pid") {
+        node.property = Property::Pid;
+        field = XLibUtilWindowInfo::Pid;
+    } else {
+        return fail(QObject::tr("Unknown field '%1'").arg(name));
+    }
+
+    skipSpace();
+    bool negate = false;
+    if (consume("!=")) {
+        negate = true;
+    } else if (consume("!~")) {
+        negate = true;
+        node.type = NodeType::Matches;
+    } else if (consume("~")) {
+        node.type = NodeType::Matches;
+    } else if (!consume("=")) {
+        return fail(QObject::tr("Expected an operator after '%1'").arg(name));
+    }
+
+    QString value;
+    if (!parseValue(&value))
+        return -1;
+
+    if (node.property == Property::Pid) {
+        bool ok;
+        node.pid = value.toInt(&ok);
+        if (node.type != NodeType::Equals || !ok)
+            return fail(QObject::tr("pid can only be compared to a number with = or !="));
+    } else if (node.type == NodeType::Matches) {
+        QRegularExpression regex(value);
+        if (!regex.isValid())
+            return fail(QObject::tr("Invalid regular expression '%1': %2").arg(value).arg(regex.errorString()));
+        node.matcher = WindowMatcher(regex);
+    } else {
+        node.value = value.toUtf8();
+    }
+
+    m_fields |= field;
+    int index = addNode(node);
+    if (negate)
+        index = addNode(NodeType::Not, index, -1);
+    return index;
+}
+
+bool MatchExpression::parseValue(QString *value)
+{
+    skipSpace();
+    if (m_pos < m_pattern.size() && m_pattern[m_pos] == '"') {
+        m_pos++;
+        while (m_pos < m_pattern.size() && m_pattern[m_pos] != '"') {
+            // A backslash escapes the next character.
+            if (m_pattern[m_pos] == '\\' && m_pos + 1 < m_pattern.size())
+                m_pos++;
+            value->append(m_pattern[m_pos]);
+            m_pos++;
+        }
+        if (m_pos >= m_pattern.size()) {
+            fail(QObject::tr("Missing closing '\"'"));
+            return false;
+        }
+        m_pos++;
+        return true;
+    }
+
+    while (m_pos < m_pattern.size() && !isValueEnd(m_pattern[m_pos])) {
+        value->append(m_pattern[m_pos]);
+        m_pos++;
+    }
+    if (value->isEmpty()) {
+        fail(QObject::tr("Expected a value"));
+        return false;
+    }
+    return true;
+}
+
+void MatchExpression::skipSpace()
+{
+    while (m_pos < m_pattern.size() && m_pattern[m_pos].isSpace()) {
+        m_pos++;
+    }
+}
+
+bool MatchExpression::consume(const char *token)
+{
+    QLatin1String t(token);
+    if (QStringView(m_pattern).mid(m_pos).startsWith(t)) {
+        m_pos += t.size();
+        return true;
+    }
+    return false;
+}
+
+int MatchExpression::fail(const QString &error)
+{
+    if (m_error.isEmpty())
+        m_error = QObject::tr("%1 at position %2").arg(error).arg(m_pos + 1);
+    return -1;
+}
+
+int MatchExpression::addNode(NodeType type, int left, int right)
+{
+    return addNode({type, Property::None, left, right, QByteArray(), 0, WindowMatcher()});
+}
+
+int MatchExpression::addNode(const Node &node)
+{
+    m_nodes.append(node);
+    return m_nodes.size() - 1;
+}
@@ -0,0 +1,119 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _MATCHEXPRESSION_H
+#define _MATCHEXPRESSION_H
+
+#include "windowmatcher.h"
+#include "xlibtypes.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+// A search pattern compiled into a predicate over a window's properties.
+//
+// A pattern is either a regular expression, which is tested against res_name,
+// then res_class, then WM_NAME, or a match expression such as
+//
+//   class=firefox && role=browser && title~"Inbox"
+//
+// Fields are class (res_class), instance (res_name), title, role and pid.
+// Operators are = (equals), != (doesn't equal), ~ (regular expression
+// matches) and !~ (doesn't match). Comparisons are combined with &&, ||, !
+// and parentheses. Values with spaces or operator characters need to be
+// double quoted. A pattern is taken as an expression when it starts with a
+// field followed by an operator.
+//
+// Compiled once and cheap to copy.
+class MatchExpression
+{
+public:
+    MatchExpression();
+    explicit MatchExpression(const QString &pattern);
+
+    static bool isExpression(const QString &pattern);
+
+    const QString &pattern() const;
+    bool isValid() const;
+    QString errorString() const;
+    // The XLibUtilWindowInfo::Field properties the expression looks at.
+    quint32 fields() const;
+
+    bool matches(const XLibUtilWindowInfo &info) const;
+
+private:
+    enum class NodeType
+    {
+        And,
+        Or,
+        Not,
+        Equals,
+        Matches,
+        // A plain regular expression pattern.
+        Legacy
+    };
+
+    enum class Property
+    {
+        None,
+        Class,
+        Instance,
+        Title,
+        Role,
+        Pid
+    };
+
+    struct Node
+    {
+        NodeType type;
+        Property property;
+        // Operands of And, Or and Not.
+        int left;
+        int right;
+        // Compared to by Equals.
+        QByteArray value;
+        pid_t pid;
+        // Used by Matches and Legacy.
+        WindowMatcher matcher;
+    };
+
+    bool evaluate(int node, const XLibUtilWindowInfo &info) const;
+
+    int parseOr();
+    int parseAnd();
+    int parseUnary();
+    int parseComparison();
+    bool parseValue(QString *value);
+    void skipSpace();
+    bool consume(const char *token);
+    int fail(const QString &error);
+    int addNode(NodeType type, int left, int right);
+    int addNode(const Node &node);
+
+    QString m_pattern;
+    QList<Node> m_nodes;
+    int m_root;
+    quint32 m_fields;
+    QString m_error;
+    // Only used while parsing.
+    int m_pos;
+};
+
+#endif // _MATCHEXPRESSION_H
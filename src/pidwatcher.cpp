@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "pidwatcher.h"
+
+#include <QTimer>
+
+#include <errno.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int pidfdOpen(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    Q_UNUSED(pid);
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+PidWatcher::PidWatcher(pid_t pid) : m_pid(pid), m_fd(-1), m_notifier(nullptr), m_exited(false)
+{
+    m_fd = pidfdOpen(pid);
+    if (m_fd == -1) {
+        // Already gone. Reported from the event loop so the caller can
+        // connect first.
+        if (errno == ESRCH) {
+            m_exited = true;
+            QTimer::singleShot(0, this, &PidWatcher::notify);
+        }
+        return;
+    }
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &PidWatcher::notify);
+}
+
+PidWatcher::~PidWatcher()
+{
+    if (m_fd != -1)
+        close(m_fd);
+}
+
+pid_t PidWatcher::pid() const
+{
+    return m_pid;
+}
+
+bool PidWatcher::isWatching() const
+{
+    return m_fd != -1 || m_exited;
+}
+
+void PidWatcher::notify()
+{
+    // Stays readable. Only reported once.
+    if (m_notifier != nullptr)
+        m_notifier->setEnabled(false);
+    emit exited(m_pid);
+}
@@ -0,0 +1,56 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _PIDWATCHER_H
+#define _PIDWATCHER_H
+
+#include <QObject>
+#include <QSocketNotifier>
+
+#include <sys/types.h>
+
+// Reports when a process exits. The process doesn't need to be a child of
+// KDocker. Uses a pidfd which becomes readable once the process is gone.
+//
+// Needs Linux 5.3 or newer. isWatching returns false when pidfd_open isn't
+// available and exited is never emitted.
+class PidWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PidWatcher(pid_t pid);
+    ~PidWatcher();
+
+    pid_t pid() const;
+    bool isWatching() const;
+
+signals:
+    void exited(pid_t pid);
+
+private:
+    void notify();
+
+    pid_t m_pid;
+    int m_fd;
+    QSocketNotifier *m_notifier;
+    bool m_exited;
+};
+
+#endif // _PIDWATCHER_H
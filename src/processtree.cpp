@@ -0,0 +1,109 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "processtree.h"
+
+#include <QDir>
+#include <QFile>
+
+void ProcessTree::setRoots(const QList<pid_t> &roots)
+{
+    for (auto it = m_descendants.begin(); it != m_descendants.end();) {
+        if (!roots.contains(it.key())) {
+            it = m_descendants.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (pid_t root : roots) {
+        if (!m_descendants.contains(root))
+            m_descendants.insert(root, QSet<pid_t>());
+    }
+}
+
+bool ProcessTree::isEmpty() const
+{
+    return m_descendants.isEmpty();
+}
+
+bool ProcessTree::refresh()
+{
+    bool added = false;
+    for (auto it = m_descendants.begin(); it != m_descendants.end(); ++it) {
+        QSet<pid_t> &descendants = it.value();
+        // Known descendants are read too. Their parent could be gone.
+        QList<pid_t> pending = descendants.values();
+        pending.append(it.key());
+        while (!pending.isEmpty()) {
+            pid_t pid = pending.takeLast();
+            QList<pid_t> pids;
+            if (!children(pid, &pids)) {
+                // The root stays until setRoots drops it.
+                if (pid != it.key())
+                    descendants.remove(pid);
+                continue;
+            }
+            for (pid_t child : std::as_const(pids)) {
+                if (child == it.key() || descendants.contains(child))
+                    continue;
+                descendants.insert(child);
+                pending.append(child);
+                added = true;
+            }
+        }
+    }
+    return added;
+}
+
+QSet<pid_t> ProcessTree::descendants(pid_t root) const
+{
+    return m_descendants.value(root);
+}
+
+bool ProcessTree::contains(pid_t pid) const
+{
+    for (auto it = m_descendants.cbegin(); it != m_descendants.cend(); ++it) {
+        if (it.key() == pid || it.value().contains(pid))
+            return true;
+    }
+    return false;
+}
+
+bool ProcessTree::children(pid_t pid, QList<pid_t> *pids)
+{
+    QDir tasks(QString("/proc/%1/task").arg(pid));
+    if (!tasks.exists())
+        return false;
+
+    const QStringList tids = tasks.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &tid : tids) {
+        QFile file(tasks.filePath(tid + "/children"));
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+
+        const QList<QByteArray> values = file.readAll().split(' ');
+        for (const QByteArray &value : values) {
+            bool ok = false;
+            pid_t child = static_cast<pid_t>(value.trimmed().toInt(&ok));
+            if (ok && child > 0)
+                pids->append(child);
+        }
+    }
+    return true;
+}
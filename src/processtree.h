@@ -0,0 +1,59 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _PROCESSTREE_H
+#define _PROCESSTREE_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+
+#include <sys/types.h>
+
+// Descendants of the processes KDocker launched. Read from
+// /proc/<pid>/task/<tid>/children, which lists the children each thread
+// started.
+//
+// Processes are remembered once seen. A child whose parent exits is moved
+// to another parent and is no longer listed, so a wrapper script that
+// starts an app and exits is only followed if the tree was refreshed in
+// between. Refresh often while searches are waiting.
+class ProcessTree
+{
+public:
+    // The processes to follow. Anything else is forgotten.
+    void setRoots(const QList<pid_t> &roots);
+    bool isEmpty() const;
+
+    // Reads the children of every known process that's still running.
+    // Descendants that exited are forgotten. Returns true if new descendants
+    // were found.
+    bool refresh();
+    QSet<pid_t> descendants(pid_t root) const;
+    // pid is a root or a known descendant.
+    bool contains(pid_t pid) const;
+
+private:
+    // Returns false if the process is gone.
+    static bool children(pid_t pid, QList<pid_t> *pids);
+
+    QHash<pid_t, QSet<pid_t>> m_descendants;
+};
+
+#endif // _PROCESSTREE_H
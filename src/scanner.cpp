@@ -23,100 +23,427 @@
 #include "xlibutil.h"
 
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
 #include <QElapsedTimer>
 #include <QMessageBox>
-#include <QProcess>
+#include <QPair>
 #include <QStringList>
 
+#include <chrono>
 #include <signal.h>
 
-Scanner::Scanner(TrayItemManager *manager)
+// How long to look for a window by class once the launched process exits.
+// An app handing off to a running instance opens its window right away.
+static const qint64 HANDOFF_TIMEOUT = 3000;
+// How often the children of launched processes are read while waiting.
+static const int PROCESS_TREE_INTERVAL = 100;
+
+Scanner::Scanner(TrayItemManager *manager, WindowRegistry *registry) : m_active(false), m_checkQueued(false)
 {
     m_manager = manager;
-    // Check every 1/4 second for a window
-    m_timer.setInterval(250);
-    connect(&m_timer, &QTimer::timeout, this, &Scanner::check);
+    m_registry = registry;
+    // Only fires when the next search expires. New windows are reported by the registry.
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &Scanner::checkExpired);
+    connect(m_registry, &WindowRegistry::windowsChanged, this, &Scanner::checkWindows);
+    m_treeTimer.setInterval(PROCESS_TREE_INTERVAL);
+    connect(&m_treeTimer, &QTimer::timeout, this, &Scanner::checkProcessTree);
+    connect(&m_launcher, &Launcher::started, this, &Scanner::launchStarted);
+    connect(&m_launcher, &Launcher::failed, this, &Scanner::launchFailed);
+    connect(&m_launcher, &Launcher::exited, this, &Scanner::processExited);
+}
+
+bool Scanner::enqueueSearch(const QString &searchPattern, quint32 maxTime, bool checkNormality,
+                            const TrayItemOptions &config, quint64 tag)
+{
+    if (maxTime == 0)
+        maxTime = 1;
+
+    MatchExpression expression;
+    if (!compile(searchPattern, &expression))
+        return false;
+
+    ScannerSearchTitle search(expression, config, maxTime, checkNormality);
+    search.setTag(tag);
+    m_searchTitle.append(search);
+    start();
+    return true;
 }
 
-void Scanner::enqueueSearch(const QRegularExpression &searchPattern, quint32 maxTime, bool checkNormality,
-                            const TrayItemOptions &config)
+bool Scanner::enqueueLaunch(const LaunchRequest &launch, const QString &searchPattern, quint32 maxTime,
+                            bool checkNormality, const TrayItemOptions &config, quint64 tag)
 {
     if (maxTime == 0)
         maxTime = 1;
 
-    m_searchTitle.append(ScannerSearchTitle(searchPattern, config, maxTime, checkNormality));
-    m_timer.start();
+    // Check the pattern first so nothing is launched that can't be found.
+    MatchExpression expression;
+    if (!searchPattern.isEmpty() && !compile(searchPattern, &expression))
+        return false;
+
+    // Apps following the startup notification spec copy DESKTOP_STARTUP_ID
+    // to _NET_STARTUP_ID on the window they open for this launch. Passed on
+    // when handing the launch off to a running instance too.
+    QByteArray startupId = newStartupId();
+    LaunchRequest request = launch;
+    if (request.environment.isEmpty())
+        request.environment = QProcessEnvironment::systemEnvironment();
+    request.environment.insert("DESKTOP_STARTUP_ID", QString::fromLatin1(startupId));
+
+    // The search starts once the launcher gets to it. Launches can be queued.
+    quint64 id = m_launcher.launch(request);
+    m_launches.insert(id, {launch.program, searchPattern.isEmpty() ? MatchExpression() : expression, startupId, maxTime,
+                           checkNormality, config, tag});
+    start();
+    return true;
 }
 
-void Scanner::enqueueLaunch(const QString &launchCommand, const QStringList &arguments,
-                            const QRegularExpression &searchPattern, quint32 maxTime, bool checkNormality,
-                            const TrayItemOptions &config)
+void Scanner::enqueuePid(pid_t pid, quint32 maxTime, bool checkNormality, const TrayItemOptions &config,
+                         quint64 tag)
 {
     if (maxTime == 0)
         maxTime = 1;
 
-    // Launch the requested application.
-    qint64 pid;
-    if (!QProcess::startDetached(launchCommand, arguments, "", &pid)) {
-        QMessageBox::warning(nullptr, tr("Launch Error"), tr("'%1' did not start properly.").arg(launchCommand));
+    // Not launched by us so there's no command and nothing reports the
+    // process exiting. The process tree still follows its children.
+    ScannerSearchPid search(QString(), pid, QByteArray(), config, maxTime, checkNormality);
+    search.setTag(tag);
+    m_searchPid.append(search);
+    m_treeTimer.start();
+    start();
+}
+
+void Scanner::setLaunchConcurrency(int concurrency)
+{
+    m_launcher.setMaxPending(concurrency);
+}
+
+void Scanner::launchStarted(quint64 id, pid_t pid)
+{
+    auto it = m_launches.find(id);
+    if (it == m_launches.end())
         return;
+    PendingLaunch launch = it.value();
+    m_launches.erase(it);
+
+    if (launch.expression.isValid()) {
+        ScannerSearchTitle search(launch.expression, launch.config, launch.maxTime, launch.checkNormality);
+        search.setLaunchId(id);
+        search.setTag(launch.tag);
+        m_searchTitle.append(search);
+    } else {
+        ScannerSearchPid search(launch.command, pid, launch.startupId, launch.config, launch.maxTime,
+                                launch.checkNormality);
+        search.setLaunchId(id);
+        search.setTag(launch.tag);
+        m_searchPid.append(search);
+        m_treeTimer.start();
     }
+    start();
+}
+
+void Scanner::launchFailed(quint64 id, const QString &error)
+{
+    PendingLaunch launch = m_launches.take(id);
+    if (launch.tag != 0)
+        m_done.append(qMakePair(launch.tag, windowid_t(0)));
+    emitDone();
+    // Reported instead of shown. Nobody might be at the screen to close a
+    // dialog for a launch started at login.
+    qWarning().noquote() << tr("'%1' did not start properly: %2").arg(launch.command).arg(error);
+    emit launchError(launch.command, error);
+
+    if (!isRunning())
+        stop();
+}
 
-    if (!searchPattern.pattern().isEmpty()) {
-        m_searchTitle.append(ScannerSearchTitle(searchPattern, config, maxTime, checkNormality));
+void Scanner::finish(ScannerSearch &search, windowid_t window)
+{
+    if (search.launchId() != 0)
+        m_launcher.settle(search.launchId());
+    if (search.tag() != 0)
+        m_done.append(qMakePair(search.tag(), window));
+}
+
+void Scanner::addError(ScannerSearch &search, const QString &error, QStringList *errors)
+{
+    // Tagged searches are reported with searchDone, such as in a manifest's
+    // report. A dialog each would pile up when many fail at once.
+    if (search.tag() != 0) {
+        qWarning().noquote() << error;
     } else {
-        m_searchPid.append(ScannerSearchPid(launchCommand, static_cast<pid_t>(pid), config, maxTime, checkNormality));
+        errors->append(error);
+    }
+}
+
+void Scanner::emitDone()
+{
+    // Taken first. A handler can queue more searches.
+    QList<QPair<quint64, windowid_t>> done;
+    done.swap(m_done);
+    for (const QPair<quint64, windowid_t> &item : std::as_const(done)) {
+        emit searchDone(item.first, item.second);
     }
-    m_timer.start();
+}
+
+QByteArray Scanner::newStartupId()
+{
+    // Unique to this launch. Has no _TIME part because KDocker doesn't know
+    // the X server time of the request that started the launch.
+    static quint64 launches = 0;
+    return QString("kdocker-%1-%2-%3")
+        .arg(QCoreApplication::applicationPid())
+        .arg(++launches)
+        .arg(QDateTime::currentMSecsSinceEpoch())
+        .toLatin1();
 }
 
 bool Scanner::isRunning()
 {
-    return !m_searchPid.isEmpty() || !m_searchTitle.isEmpty();
+    return !m_searchPid.isEmpty() || !m_searchTitle.isEmpty() || !m_launches.isEmpty();
 }
 
-void Scanner::checkPid()
+void Scanner::start()
 {
-    // Counting backwards because we can remove items from the list
-    for (size_t i = m_searchPid.count(); i-- > 0;) {
-        ScannerSearchPid &search = m_searchPid[i];
+    m_active = true;
+    // The window could already exist. Checked once control returns to the
+    // event loop like windows found later are. Searches queued together,
+    // such as from a manifest, share the pass.
+    if (!m_checkQueued) {
+        m_checkQueued = true;
+        QTimer::singleShot(0, this, &Scanner::checkAll);
+    }
+    scheduleExpiry();
+}
 
-        windowid_t window = XLibUtil::pidToWid(search.checkNormality(), search.pid());
-        if (window != 0) {
-            emit windowFound(window, search.config());
-            m_searchPid.remove(i);
-        } else if (search.hasExpired()) {
-            QMessageBox::warning(nullptr, tr("Error"), tr("Could not find a window for '%1'").arg(search.launchCommand()));
-            m_searchPid.remove(i);
+void Scanner::stop()
+{
+    if (!m_active)
+        return;
+
+    m_active = false;
+    m_timer.stop();
+    m_treeTimer.stop();
+    m_processTree.setRoots({});
+    emit stopping();
+}
+
+void Scanner::checkAll()
+{
+    m_checkQueued = false;
+    if (!isRunning())
+        return;
+
+    refreshProcessTree();
+    check(m_registry->findWindows(searches(), m_manager->dockedWindows()));
+    if (!isRunning())
+        stop();
+}
+
+void Scanner::checkWindows(const QList<windowid_t> &windows)
+{
+    if (!isRunning())
+        return;
+
+    // A window could belong to a process started since the last refresh.
+    // Only worth reading /proc for when its pid isn't known yet.
+    for (windowid_t window : windows) {
+        pid_t pid = m_registry->info(window).pid;
+        if (pid > 0 && !m_processTree.contains(pid)) {
+            refreshProcessTree();
+            break;
         }
     }
+    check(m_registry->findWindows(searches(), windows, m_manager->dockedWindows()));
+    if (!isRunning())
+        stop();
+}
+
+void Scanner::checkProcessTree()
+{
+    // A new descendant's window could already be known.
+    if (refreshProcessTree())
+        checkAll();
 }
 
-void Scanner::checkTitle()
+bool Scanner::refreshProcessTree()
 {
+    QList<pid_t> roots;
+    for (ScannerSearchPid &search : m_searchPid) {
+        if (!search.hasExited())
+            roots.append(search.pid());
+    }
+    m_processTree.setRoots(roots);
+    if (m_processTree.isEmpty()) {
+        m_treeTimer.stop();
+        return false;
+    }
+    return m_processTree.refresh();
+}
+
+bool Scanner::compile(const QString &searchPattern, MatchExpression *expression)
+{
+    *expression = MatchExpression(searchPattern);
+    if (!expression->isValid()) {
+        QMessageBox::warning(nullptr, tr("Error"),
+                             tr("Invalid search pattern '%1': %2").arg(searchPattern).arg(expression->errorString()));
+        return false;
+    }
+    return true;
+}
+
+QList<XLibUtilWindowSearch> Scanner::searches()
+{
+    // Pid searches first, then title searches. check relies on this order.
+    QList<XLibUtilWindowSearch> searches;
+    for (ScannerSearchPid &search : m_searchPid) {
+        if (search.hasExited()) {
+            searches.append({0, search.fallback(), search.checkNormality(), {}, search.startupId()});
+        } else {
+            searches.append({search.pid(), MatchExpression(), search.checkNormality(),
+                             m_processTree.descendants(search.pid()), search.startupId()});
+        }
+    }
+    for (ScannerSearchTitle &search : m_searchTitle) {
+        searches.append({0, search.expression(), search.checkNormality()});
+    }
+    return searches;
+}
+
+void Scanner::check(const QList<windowid_t> &windows)
+{
+    // Take the found searches out of the lists before anything is docked.
+    QList<QPair<windowid_t, TrayItemOptions>> found;
+    size_t pidCount = m_searchPid.count();
+
     // Counting backwards because we can remove items from the list
     for (size_t i = m_searchTitle.count(); i-- > 0;) {
-        ScannerSearchTitle &search = m_searchTitle[i];
-        const QRegularExpression searchPattern = search.searchPattern();
-
-        windowid_t window = XLibUtil::findWindow(search.checkNormality(), searchPattern, m_manager->dockedWindows());
+        windowid_t window = windows[pidCount + i];
         if (window != 0) {
-            emit windowFound(window, search.config());
-            m_searchTitle.remove(i);
-        } else if (search.hasExpired()) {
-            QMessageBox::warning(nullptr, tr("Error"), tr("Could not find a window matching for '%1'").arg(searchPattern.pattern()));
+            found.append(qMakePair(window, m_searchTitle[i].config()));
+            finish(m_searchTitle[i], window);
             m_searchTitle.remove(i);
         }
     }
+    for (size_t i = pidCount; i-- > 0;) {
+        windowid_t window = windows[i];
+        if (window != 0) {
+            found.append(qMakePair(window, m_searchPid[i].config()));
+            finish(m_searchPid[i], window);
+            m_searchPid.remove(i);
+        }
+    }
+
+    for (const QPair<windowid_t, TrayItemOptions> &item : std::as_const(found)) {
+        emit windowFound(item.first, item.second);
+    }
+    emitDone();
+}
+
+void Scanner::processExited(pid_t pid)
+{
+    refreshProcessTree();
+
+    // Searches that can't fall back are done. The rest look for a window of
+    // a running instance for a short time. Removed before showing any
+    // message for the same reason as checkExpired.
+    QStringList errors;
+    for (size_t i = m_searchPid.count(); i-- > 0;) {
+        ScannerSearchPid &search = m_searchPid[i];
+        if (search.pid() != pid || search.hasExited())
+            continue;
+        // A wrapper that started the app and exited. The app's window is
+        // still looked for.
+        if (!m_processTree.descendants(pid).isEmpty())
+            continue;
+
+        if (search.fallback().isValid()) {
+            search.setExited();
+            search.expireWithin(HANDOFF_TIMEOUT);
+        } else {
+            addError(search, tr("'%1' exited without opening a window").arg(search.launchCommand()), &errors);
+            finish(search, 0);
+            m_searchPid.remove(i);
+        }
+    }
+
+    // The running instance's window could already exist.
+    if (isRunning()) {
+        check(m_registry->findWindows(searches(), m_manager->dockedWindows()));
+        scheduleExpiry();
+    }
+    emitDone();
+
+    for (const QString &error : std::as_const(errors)) {
+        QMessageBox::warning(nullptr, tr("Error"), error);
+    }
+
+    if (!isRunning()) {
+        stop();
+    }
 }
 
-void Scanner::check()
+void Scanner::scheduleExpiry()
 {
-    checkPid();
-    checkTitle();
+    qint64 next = -1;
+    for (ScannerSearchPid &search : m_searchPid) {
+        qint64 remaining = search.remainingTime();
+        if (next < 0 || remaining < next)
+            next = remaining;
+    }
+    for (ScannerSearchTitle &search : m_searchTitle) {
+        qint64 remaining = search.remainingTime();
+        if (next < 0 || remaining < next)
+            next = remaining;
+    }
 
-    if (m_searchPid.isEmpty() && m_searchTitle.isEmpty()) {
+    if (next < 0) {
         m_timer.stop();
-        emit stopping();
+    } else {
+        m_timer.start(std::chrono::milliseconds(next));
+    }
+}
+
+void Scanner::checkExpired()
+{
+    // Look one last time asking the X server directly. This finds windows the
+    // registry doesn't have, such as when there isn't a window manager.
+    check(XLibUtil::findWindows(searches(), m_manager->dockedWindows()));
+
+    // Remove expired searches before showing any message. The message box runs
+    // its own event loop which can get back into the scanner.
+    QStringList errors;
+    for (size_t i = m_searchPid.count(); i-- > 0;) {
+        ScannerSearchPid &search = m_searchPid[i];
+        if (search.hasExpired()) {
+            if (search.launchCommand().isEmpty()) {
+                addError(search, tr("Could not find a window for pid %1").arg(search.pid()), &errors);
+            } else {
+                addError(search, tr("Could not find a window for '%1'").arg(search.launchCommand()), &errors);
+            }
+            finish(search, 0);
+            m_searchPid.remove(i);
+        }
+    }
+    for (size_t i = m_searchTitle.count(); i-- > 0;) {
+        ScannerSearchTitle &search = m_searchTitle[i];
+        if (search.hasExpired()) {
+            addError(search, tr("Could not find a window matching for '%1'").arg(search.searchPattern()), &errors);
+            finish(search, 0);
+            m_searchTitle.remove(i);
+        }
+    }
+
+    if (isRunning())
+        scheduleExpiry();
+    emitDone();
+
+    for (const QString &error : std::as_const(errors)) {
+        QMessageBox::warning(nullptr, tr("Error"), error);
+    }
+
+    if (!isRunning()) {
+        stop();
     }
 }
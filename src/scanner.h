@@ -20,13 +20,20 @@
 #ifndef _SCANNER_H
 #define _SCANNER_H
 
+#include "launcher.h"
+#include "processtree.h"
 #include "scannersearch.h"
 #include "trayitemoptions.h"
+#include "windowregistry.h"
+#include "xlibutil.h"
 
+#include <QByteArray>
+#include <QHash>
 #include <QList>
 #include <QObject>
-#include <QRegularExpression>
+#include <QPair>
 #include <QString>
+#include <QStringList>
 #include <QTimer>
 
 // Forward declared because trayitemmanager.h incldues scanner.h
@@ -34,33 +41,95 @@ class TrayItemManager;
 
 // Launches commands and looks for the window ids they create.
 // Looks for windows based on a search pattern.
+//
+// Searches are driven by the window registry. Only windows that appear or
+// change are checked and they're checked from memory.
 class Scanner : public QObject
 {
     Q_OBJECT
 
 public:
-    Scanner(TrayItemManager *manager);
-    void enqueueSearch(const QRegularExpression &searchPattern, quint32 maxTime, bool checkNormality,
-                       const TrayItemOptions &config);
-    void enqueueLaunch(const QString &launchCommand, const QStringList &arguments,
-                       const QRegularExpression &searchPattern, quint32 maxTime, bool checkNormality,
-                       const TrayItemOptions &config);
+    Scanner(TrayItemManager *manager, WindowRegistry *registry);
+    // searchPattern is a regular expression or a match expression. See MatchExpression.
+    // A non-zero tag is passed back with searchDone. Returns false if the
+    // pattern can't be used and nothing was queued.
+    bool enqueueSearch(const QString &searchPattern, quint32 maxTime, bool checkNormality,
+                       const TrayItemOptions &config, quint64 tag = 0);
+    // The startup id is added to the environment of launch, or to KDocker's
+    // if it's empty.
+    bool enqueueLaunch(const LaunchRequest &launch, const QString &searchPattern, quint32 maxTime,
+                       bool checkNormality, const TrayItemOptions &config, quint64 tag = 0);
+    // Looks for a window of a process that's already running.
+    void enqueuePid(pid_t pid, quint32 maxTime, bool checkNormality, const TrayItemOptions &config,
+                    quint64 tag = 0);
+    // Launches started and waiting for their window at once.
+    void setLaunchConcurrency(int concurrency);
     bool isRunning();
 
 private slots:
-    void check();
-    void checkPid();
-    void checkTitle();
+    void checkAll();
+    void checkWindows(const QList<windowid_t> &windows);
+    void checkExpired();
+    void launchStarted(quint64 id, pid_t pid);
+    void launchFailed(quint64 id, const QString &error);
+    void processExited(pid_t pid);
+    void checkProcessTree();
 
 signals:
     void windowFound(windowid_t, const TrayItemOptions &);
+    // A tagged search finished. window is 0 if none was found. Emitted after
+    // windowFound.
+    void searchDone(quint64 tag, windowid_t window);
+    // A launch couldn't be started. Emitted after its searchDone.
+    void launchError(const QString &command, const QString &error);
     void stopping();
 
 private:
+    static QByteArray newStartupId();
+    // Called when a search is removed. Lets the launcher start the next
+    // launch and queues searchDone for tagged searches.
+    void finish(ScannerSearch &search, windowid_t window);
+    // Adds error to the ones shown once the searches are updated. Only
+    // logged for tagged searches.
+    void addError(ScannerSearch &search, const QString &error, QStringList *errors);
+    void emitDone();
+    void start();
+    void stop();
+    // Shows an error and returns false if the pattern can't be used.
+    bool compile(const QString &searchPattern, MatchExpression *expression);
+    QList<XLibUtilWindowSearch> searches();
+    void check(const QList<windowid_t> &windows);
+    void scheduleExpiry();
+    // Returns true if launched processes have new descendants.
+    bool refreshProcessTree();
+
     TrayItemManager *m_manager;
+    WindowRegistry *m_registry;
     QTimer m_timer;
+    // Follows the descendants of launched processes while their searches wait.
+    ProcessTree m_processTree;
+    QTimer m_treeTimer;
+    // Launches waiting for the launcher. Their search is added once started.
+    struct PendingLaunch
+    {
+        QString command;
+        // Invalid for a pid search.
+        MatchExpression expression;
+        QByteArray startupId;
+        quint32 maxTime;
+        bool checkNormality;
+        TrayItemOptions config;
+        quint64 tag;
+    };
+    Launcher m_launcher;
+    QHash<quint64, PendingLaunch> m_launches;
     QList<ScannerSearchPid> m_searchPid;
     QList<ScannerSearchTitle> m_searchTitle;
+    // Tagged searches finished and not yet reported with searchDone.
+    QList<QPair<quint64, windowid_t>> m_done;
+    bool m_active;
+    // One pass checks every search queued before it runs.
+    bool m_checkQueued;
 };
 
 #endif // _SCANNER_H
@@ -19,8 +19,25 @@
 
 #include "scannersearch.h"
 
+#include <QFileInfo>
+#include <QRegularExpression>
+
+// Matches res_class or res_name to the name of the launched command,
+// ignoring case. Invalid if the name is empty.
+static MatchExpression fallbackExpression(const QString &launchCommand)
+{
+    QString name = QFileInfo(launchCommand).fileName();
+    if (name.isEmpty())
+        return MatchExpression();
+
+    QString regex = "(?i)^" + QRegularExpression::escape(name) + "$";
+    // Quoted for the match expression.
+    regex.replace("\\", "\\\\").replace("\"", "\\\"");
+    return MatchExpression(QString("class~\"%1\" || instance~\"%1\"").arg(regex));
+}
+
 ScannerSearch::ScannerSearch(const TrayItemOptions &config, uint64_t timeout, bool checkNormality)
-    : m_config(config), m_checkNormality(checkNormality)
+    : m_config(config), m_checkNormality(checkNormality), m_launchId(0), m_tag(0)
 {
     m_timeout = timeout * 1000;
     m_etimer.start();
@@ -41,9 +58,41 @@ bool ScannerSearch::hasExpired()
     return m_etimer.hasExpired(m_timeout);
 }
 
-ScannerSearchPid::ScannerSearchPid(const QString &launchCommand, pid_t pid, const TrayItemOptions &config,
-                                   uint64_t timeout, bool checkNormality)
-    : ScannerSearch(config, timeout, checkNormality), m_launchCommand(launchCommand), m_pid(pid)
+qint64 ScannerSearch::remainingTime()
+{
+    return qMax<qint64>(0, static_cast<qint64>(m_timeout) - m_etimer.elapsed());
+}
+
+void ScannerSearch::expireWithin(qint64 msecs)
+{
+    if (msecs < remainingTime())
+        m_timeout = static_cast<uint64_t>(m_etimer.elapsed() + msecs);
+}
+
+quint64 ScannerSearch::launchId()
+{
+    return m_launchId;
+}
+
+void ScannerSearch::setLaunchId(quint64 id)
+{
+    m_launchId = id;
+}
+
+quint64 ScannerSearch::tag()
+{
+    return m_tag;
+}
+
+void ScannerSearch::setTag(quint64 tag)
+{
+    m_tag = tag;
+}
+
+ScannerSearchPid::ScannerSearchPid(const QString &launchCommand, pid_t pid, const QByteArray &startupId,
+                                   const TrayItemOptions &config, uint64_t timeout, bool checkNormality)
+    : ScannerSearch(config, timeout, checkNormality), m_launchCommand(launchCommand), m_pid(pid),
+      m_startupId(startupId), m_exited(false), m_fallback(fallbackExpression(launchCommand))
 {}
 
 const QString ScannerSearchPid::launchCommand()
@@ -56,12 +105,37 @@ pid_t ScannerSearchPid::pid()
     return m_pid;
 }
 
-ScannerSearchTitle::ScannerSearchTitle(const QRegularExpression &searchPattern, const TrayItemOptions &config,
+const QByteArray &ScannerSearchPid::startupId()
+{
+    return m_startupId;
+}
+
+bool ScannerSearchPid::hasExited()
+{
+    return m_exited;
+}
+
+void ScannerSearchPid::setExited()
+{
+    m_exited = true;
+}
+
+const MatchExpression &ScannerSearchPid::fallback()
+{
+    return m_fallback;
+}
+
+ScannerSearchTitle::ScannerSearchTitle(const MatchExpression &expression, const TrayItemOptions &config,
                                        uint64_t timeout, bool checkNormality)
-    : ScannerSearch(config, timeout, checkNormality), m_searchPattern(searchPattern)
+    : ScannerSearch(config, timeout, checkNormality), m_expression(expression)
 {}
 
-const QRegularExpression &ScannerSearchTitle::searchPattern()
+const QString &ScannerSearchTitle::searchPattern()
+{
+    return m_expression.pattern();
+}
+
+const MatchExpression &ScannerSearchTitle::expression()
 {
-    return m_searchPattern;
+    return m_expression;
 }
@@ -21,10 +21,11 @@
 #define _SCANNERSEARCH_H
 
 #include "trayitemoptions.h"
+#include "matchexpression.h"
 #include "xlibtypes.h"
 
+#include <QByteArray>
 #include <QElapsedTimer>
-#include <QRegularExpression>
 #include <QString>
 
 class ScannerSearch
@@ -35,6 +36,16 @@ public:
     const TrayItemOptions &config();
     bool checkNormality();
     bool hasExpired();
+    // Milliseconds until the search expires.
+    qint64 remainingTime();
+    // Expires the search in msecs if that's sooner than the timeout.
+    void expireWithin(qint64 msecs);
+    // The Launcher id of the launch the search is for. 0 if it isn't for one.
+    quint64 launchId();
+    void setLaunchId(quint64 id);
+    // Passed back with Scanner::searchDone. 0 if the caller isn't told.
+    quint64 tag();
+    void setTag(quint64 tag);
 
 private:
     TrayItemOptions m_config;
@@ -42,32 +53,50 @@ private:
 
     QElapsedTimer m_etimer;
     uint64_t m_timeout;
+    quint64 m_launchId;
+    quint64 m_tag;
 };
 
 class ScannerSearchPid : public ScannerSearch
 {
 public:
-    ScannerSearchPid(const QString &launchCommand, pid_t pid, const TrayItemOptions &config, uint64_t timeout,
-                     bool checkNormality);
+    ScannerSearchPid(const QString &launchCommand, pid_t pid, const QByteArray &startupId,
+                     const TrayItemOptions &config, uint64_t timeout, bool checkNormality);
 
     const QString launchCommand();
     pid_t pid();
+    // DESKTOP_STARTUP_ID the process was started with.
+    const QByteArray &startupId();
+
+    // The launched process exited. Windows are matched with fallback from
+    // now on.
+    bool hasExited();
+    void setExited();
+    // Matches windows by WM_CLASS against the command's name. For apps that
+    // hand the launch off to an already running instance and exit. Not valid
+    // when the command's name can't be used.
+    const MatchExpression &fallback();
 
 private:
     QString m_launchCommand;
     pid_t m_pid;
+    QByteArray m_startupId;
+    bool m_exited;
+    MatchExpression m_fallback;
 };
 
 class ScannerSearchTitle : public ScannerSearch
 {
 public:
-    ScannerSearchTitle(const QRegularExpression &searchPattern, const TrayItemOptions &config, uint64_t timeout,
+    ScannerSearchTitle(const MatchExpression &expression, const TrayItemOptions &config, uint64_t timeout,
                        bool checkNormality);
 
-    const QRegularExpression &searchPattern();
+    const QString &searchPattern();
+    const MatchExpression &expression();
 
 private:
-    QRegularExpression m_searchPattern;
+    // Compiled once and used for every check.
+    MatchExpression m_expression;
 };
 
 #endif // _SCANNERSEARCH_H
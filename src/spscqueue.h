@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _SPSCQUEUE_H
+#define _SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Fixed size queue for passing items from one thread to another without
+// locking. Only one thread may push and only one thread may pop.
+template <typename T> class SpscQueue
+{
+public:
+    // One slot is always left empty to tell a full queue from an empty one.
+    explicit SpscQueue(size_t capacity)
+        : m_size(capacity + 1), m_items(std::make_unique<T[]>(capacity + 1)), m_head(0), m_tail(0)
+    {}
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer thread. Returns false, leaving value untouched, when full.
+    bool push(T &&value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t next = (tail + 1) % m_size;
+        if (next == m_head.load(std::memory_order_acquire))
+            return false;
+
+        m_items[tail] = std::move(value);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool push(const T &value)
+    {
+        T copy(value);
+        return push(std::move(copy));
+    }
+
+    // Consumer thread. Returns false when empty.
+    bool pop(T &value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        value = std::move(m_items[head]);
+        // Don't hold on to what the item owned until the slot is reused.
+        m_items[head] = T();
+        m_head.store((head + 1) % m_size, std::memory_order_release);
+        return true;
+    }
+
+private:
+    const size_t m_size;
+    std::unique_ptr<T[]> m_items;
+    // Written by the consumer.
+    alignas(64) std::atomic<size_t> m_head;
+    // Written by the producer.
+    alignas(64) std::atomic<size_t> m_tail;
+};
+
+#endif // _SPSCQUEUE_H
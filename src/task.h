@@ -0,0 +1,194 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _TASK_H
+#define _TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// The result of a coroutine. Coroutines run on the thread that calls them,
+// which is the GUI thread for everything in KDocker, until they suspend
+// waiting on something. They're resumed from the Qt event loop once what
+// they're waiting on is ready. Nothing blocks and no nested event loop is
+// needed.
+//
+// The coroutine starts running when it's called. The result is either
+// co_await'ed from another coroutine or passed to a callback with then().
+// A task that's dropped before it finishes keeps running and cleans up
+// after itself.
+//
+// Parameters are copied into the coroutine so they need to be passed by
+// value. A member coroutine needs to check its object still exists after
+// every co_await (QPointer).
+template <typename T> class Task;
+
+namespace TaskDetail
+{
+template <typename Promise> struct FinalAwaiter
+{
+    bool await_ready() noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+    {
+        Promise &promise = handle.promise();
+        promise.finished();
+        if (promise.continuation)
+            return promise.continuation;
+        if (promise.detached)
+            handle.destroy();
+        return std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+};
+
+struct PromiseBase
+{
+    // The coroutine co_await'ing this one.
+    std::coroutine_handle<> continuation;
+    // The Task was dropped. The coroutine frees itself when it finishes.
+    bool detached = false;
+
+    std::suspend_never initial_suspend() noexcept
+    {
+        return {};
+    }
+    void unhandled_exception()
+    {
+        std::terminate();
+    }
+};
+
+template <typename T> struct Promise : PromiseBase
+{
+    using Callback = std::function<void(T)>;
+
+    std::optional<T> value;
+    Callback callback;
+
+    Task<T> get_return_object();
+    FinalAwaiter<Promise> final_suspend() noexcept
+    {
+        return {};
+    }
+    void return_value(T v)
+    {
+        value = std::move(v);
+    }
+    void finished()
+    {
+        if (callback)
+            callback(std::move(*value));
+    }
+};
+
+template <> struct Promise<void> : PromiseBase
+{
+    using Callback = std::function<void()>;
+
+    Callback callback;
+
+    Task<void> get_return_object();
+    FinalAwaiter<Promise> final_suspend() noexcept
+    {
+        return {};
+    }
+    void return_void() {}
+    void finished()
+    {
+        if (callback)
+            callback();
+    }
+};
+} // namespace TaskDetail
+
+template <typename T> class Task
+{
+public:
+    using promise_type = TaskDetail::Promise<T>;
+
+    Task(Task &&other) : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+    ~Task()
+    {
+        if (!m_handle)
+            return;
+        if (m_handle.done()) {
+            m_handle.destroy();
+        } else {
+            m_handle.promise().detached = true;
+        }
+    }
+
+    bool await_ready() const
+    {
+        return m_handle.done();
+    }
+
+    void await_suspend(std::coroutine_handle<> continuation)
+    {
+        m_handle.promise().continuation = continuation;
+    }
+
+    T await_resume()
+    {
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*m_handle.promise().value);
+    }
+
+    // Calls callback with the result once the coroutine finishes. Right away
+    // if it already has. The task can be dropped after this is called.
+    void then(typename promise_type::Callback callback)
+    {
+        if (!m_handle.done()) {
+            m_handle.promise().callback = std::move(callback);
+        } else if constexpr (std::is_void_v<T>) {
+            callback();
+        } else {
+            callback(std::move(*m_handle.promise().value));
+        }
+    }
+
+private:
+    friend promise_type;
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template <typename T> Task<T> TaskDetail::Promise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<Promise>::from_promise(*this));
+}
+
+inline Task<void> TaskDetail::Promise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<Promise>::from_promise(*this));
+}
+
+#endif // _TASK_H
@@ -19,45 +19,64 @@
  */
 
 #include "trayitem.h"
+#include "windowregistry.h"
 #include "xlibutil.h"
+#include "xworker.h"
 
 #include <QElapsedTimer>
 #include <QFileDialog>
 #include <QIcon>
 #include <QImageReader>
 #include <QPixmap>
+#include <QPointer>
 #include <QStringBuilder>
 #include <QWheelEvent>
 
 #include <xcb/xproto.h>
 
 static const QString GLOBALSKEY = "_GLOBAL_DEFAULTS";
+// How long to wait for the window manager to iconify a window before
+// withdrawing it anyway.
+static const int WITHDRAW_TIMEOUT = 500;
+// How long after asking for an iconify an Iconic WM_STATE or UnmapNotify is
+// taken as the window manager's answer.
+static const qint64 ICONIFY_ANSWER_TIMEOUT = 2000;
 
-TrayItem::TrayItem(windowid_t window, const TrayItemOptions &args)
+TrayItem::TrayItem(windowid_t window, const TrayItemOptions &args, WindowRegistry *registry, XWorker *worker)
 {
     m_wantsAttention = false;
     m_iconified = false;
     m_customIcon = false;
+    m_withdrawPending = false;
 
     m_dockedAppName = "";
     m_window = window;
+    m_alive = true;
+    m_registry = registry;
+    m_worker = worker;
 
     m_sizeHint = XLibUtil::newSizeHints();
 
+    m_withdrawTimer.setSingleShot(true);
+    m_withdrawTimer.setInterval(WITHDRAW_TIMEOUT);
+    connect(&m_withdrawTimer, &QTimer::timeout, this, &TrayItem::withdrawWindow);
+
     // Allows events from m_window to be forwarded to the x11EventFilter.
-    XLibUtil::subscribe(m_window);
+    m_subscription = XLibUtil::subscribe(m_window);
+    m_registry->hold(m_window);
 
     // Store the desktop on which the window is being shown.
     m_desktop = XLibUtil::getWindowDesktop(m_window);
 
     readDockedAppName();
     m_settings.loadSettings(m_dockedAppName, args);
-    updateTitle();
+    // Read now so there's an icon before the tray icon is shown.
+    readTitle();
 
     if (!m_settings.getIconPath().isEmpty()) {
         setCustomIcon(m_settings.getIconPath());
     } else {
-        updateIcon();
+        readIcon();
     }
 
     if (!m_settings.getAttentionIconPath().isEmpty())
@@ -78,7 +97,8 @@ TrayItem::TrayItem(windowid_t window, const TrayItemOptions &args)
 TrayItem::~TrayItem()
 {
     // No further interest in events from undocked window.
-    XLibUtil::unSubscribe(m_window);
+    XLibUtil::unSubscribe(m_subscription);
+    m_registry->release(m_window);
     XLibUtil::deleteSizeHints(m_sizeHint);
 }
 
@@ -99,6 +119,15 @@ bool TrayItem::xcbEventFilter(void *message)
             break;
 
         case XCB_UNMAP_NOTIFY:
+            // The window manager unmaps the window when it iconifies it.
+            if (m_withdrawPending) {
+                withdrawWindow();
+                break;
+            }
+            if (iconifyExpected()) {
+                iconifyAnswered();
+                break;
+            }
             // In KDE 5.14 they started issuing an unmap event when the user
             // changes virtual desktops so we need to check that the window
             // is on the current desktop before saying that it has been iconized
@@ -116,30 +145,41 @@ bool TrayItem::xcbEventFilter(void *message)
         case XCB_VISIBILITY_NOTIFY:
             if (reinterpret_cast<xcb_visibility_notify_event_t *>(event)->state == XCB_VISIBILITY_FULLY_OBSCURED) {
                 obscureEvent();
+            } else if (m_restoreTimer.isValid()) {
+                // Visible again after being restored.
+                emit restored(m_settings.getHideStrategy(), m_restoreTimer.elapsed());
+                m_restoreTimer.invalidate();
             }
             break;
 
         case XCB_PROPERTY_NOTIFY: {
-            if (isBadWindow())
-                break;
-
-            static atom_t WM_NAME = XLibUtil::getAtom("WM_NAME");
-            static atom_t WM_ICON = XLibUtil::getAtom("WM_ICON");
-            static atom_t WM_STATE = XLibUtil::getAtom("WM_STATE");
-            static atom_t _NET_WM_DESKTOP = XLibUtil::getAtom("_NET_WM_DESKTOP");
-
+            const XLibUtilAtoms &atoms = XLibUtil::atoms();
             atom_t property = static_cast<atom_t>(reinterpret_cast<xcb_property_notify_event_t *>(event)->atom);
-            if (property == WM_NAME) {
+            if (property == atoms.WM_NAME) {
                 updateTitle();
-            } else if (property == WM_ICON) {
+            } else if (property == atoms.WM_ICON) {
                 updateIcon();
-            } else if (property == _NET_WM_DESKTOP) {
-                m_desktop = XLibUtil::getWindowDesktop(m_window);
-            } else if (property == WM_STATE) {
+            } else if (property == atoms._NET_WM_DESKTOP) {
+                XLibUtilError error;
+                long desktop = XLibUtil::getWindowDesktop(m_window, &error);
+                if (!checkError(error))
+                    m_desktop = desktop;
+            } else if (property == atoms.WM_STATE) {
                 // KDE 5.14 started issuing this event when the user changes virtual desktops so
                 // a minimizeEvent() should not be executed unless the window is on the currently
                 // visible desktop
-                if (XLibUtil::isWindowIconic(m_window) && isOnCurrentDesktop()) {
+                XLibUtilError error;
+                bool iconic = XLibUtil::isWindowIconic(m_window, &error);
+                if (checkError(error) || !iconic)
+                    break;
+                if (m_withdrawPending) {
+                    // We asked for this. Not the user minimizing the window.
+                    withdrawWindow();
+                } else if (iconifyExpected()) {
+                    iconifyAnswered();
+                } else if (!m_iconified && isOnCurrentDesktop()) {
+                    // Not when already hidden. Window managers can rewrite
+                    // WM_STATE while the window stays iconic.
                     minimizeEvent();
                 }
             }
@@ -173,8 +213,17 @@ void TrayItem::restoreWindow()
     if (isBadWindow())
         return;
 
+    // Each step is a message to the window manager. Send them together.
+    XLibUtilBatch batch;
+
+    // Shown again before it was hidden.
+    m_withdrawPending = false;
+    m_withdrawTimer.stop();
+
     if (m_iconified) {
         m_iconified = false;
+        // Timed until the window is visible.
+        m_restoreTimer.start();
         XLibUtil::setWMSizeHints(m_window, m_sizeHint);
         updateToggleAction();
 
@@ -186,7 +235,9 @@ void TrayItem::restoreWindow()
     XLibUtil::raiseWindow(m_window);
 
     // Change to the desktop that the window was last on.
-    XLibUtil::setCurrentDesktop(m_desktop);
+    long currentDesktop = m_registry->currentDesktop();
+    if (m_desktop != currentDesktop && m_desktop >= 0 && m_desktop < m_registry->desktopCount())
+        XLibUtil::setCurrentDesktop(m_desktop);
 
     if (m_settings.getLockToDesktop()) {
         // Set the desktop the window wants to be on.
@@ -206,11 +257,44 @@ void TrayItem::iconifyWindow()
         return;
 
     m_iconified = true;
+    updateToggleAction();
+    // Already being hidden.
+    if (m_withdrawPending)
+        return;
 
-    // Get screen number
+    m_restoreTimer.invalidate();
     XLibUtil::getWMSizeHints(m_window, m_sizeHint);
-    XLibUtil::iconifyWindow(m_window);
-    updateToggleAction();
+    switch (m_settings.getHideStrategy()) {
+        case TrayItemOptions::HideStrategy::Unset:
+        case TrayItemOptions::HideStrategy::Withdraw:
+            // The window is withdrawn once the window manager reports it iconified
+            // (WM_STATE or UnmapNotify) instead of blocking until it has. Hiding
+            // several windows overlaps.
+            XLibUtil::iconifyWindow(m_window);
+            m_iconifyRequested.start();
+            m_withdrawPending = true;
+            m_withdrawTimer.start();
+            break;
+        case TrayItemOptions::HideStrategy::Iconic:
+            XLibUtil::iconifyWindow(m_window);
+            m_iconifyRequested.start();
+            break;
+        case TrayItemOptions::HideStrategy::Unmap:
+            XLibUtil::unmapWindow(m_window);
+            break;
+    }
+}
+
+void TrayItem::withdrawWindow()
+{
+    if (!m_withdrawPending)
+        return;
+    m_withdrawPending = false;
+    m_withdrawTimer.stop();
+
+    if (isBadWindow())
+        return;
+    XLibUtil::withdrawWindow(m_window);
 }
 
 void TrayItem::closeWindow()
@@ -412,7 +496,7 @@ void TrayItem::setBalloonTimeout(bool value)
 
 void TrayItem::toggleWindow()
 {
-    if (m_iconified || m_window != XLibUtil::getActiveWindow()) {
+    if (m_iconified || m_window != m_registry->activeWindow()) {
         // Iconify on original desktop in case restoring to another
         if (!m_iconified && !isOnCurrentDesktop()) {
             iconifyWindow();
@@ -466,9 +550,27 @@ void TrayItem::minimizeEvent()
         iconifyWindow();
 }
 
+bool TrayItem::iconifyExpected()
+{
+    return m_iconifyRequested.isValid() && !m_iconifyRequested.hasExpired(ICONIFY_ANSWER_TIMEOUT);
+}
+
+void TrayItem::iconifyAnswered()
+{
+    // Restored before the window manager got to the iconify. The window
+    // manager iconified it anyway so it's shown again.
+    if (!m_iconified)
+        restoreWindow();
+}
+
 void TrayItem::destroyEvent()
 {
-    m_window = 0;
+    if (!m_alive)
+        return;
+
+    m_alive = false;
+    m_withdrawPending = false;
+    m_withdrawTimer.stop();
     emit dead(this);
 }
 
@@ -489,7 +591,10 @@ void TrayItem::readDockedAppName()
     if (isBadWindow())
         return;
 
-    m_dockedAppName = XLibUtil::getAppName(m_window);
+    XLibUtilError error;
+    QString name = XLibUtil::getAppName(m_window, &error);
+    if (!checkError(error))
+        m_dockedAppName = name;
 }
 
 // Update the title in the tooltip.
@@ -498,8 +603,31 @@ void TrayItem::updateTitle()
     if (isBadWindow())
         return;
 
-    QString title = XLibUtil::getWindowTitle(m_window);
+    if (m_worker == nullptr || !m_worker->requestTitle(m_window))
+        readTitle();
+}
+
+void TrayItem::readTitle()
+{
+    if (isBadWindow())
+        return;
+
+    XLibUtilError error;
+    QString title = XLibUtil::getWindowTitle(m_window, &error);
+    if (checkError(error))
+        return;
+    showTitle(title);
+}
 
+void TrayItem::titleRead(const QString &title)
+{
+    if (isBadWindow())
+        return;
+    showTitle(title);
+}
+
+void TrayItem::showTitle(const QString &title)
+{
     setToolTip(QString("%1 [%2]").arg(title).arg(m_dockedAppName));
     if (!m_settings.getQuiet()) {
         // Using nonZeroBalloonTimeout because previous versions of KDocker settings wouldn't
@@ -518,7 +646,48 @@ void TrayItem::updateIcon()
     if (isBadWindow() || m_customIcon)
         return;
 
-    QPixmap pm = XLibUtil::getWindowIcon(m_window);
+    // _NET_WM_ICON can be megabytes.
+    if (m_worker == nullptr || !m_worker->requestIcon(m_window))
+        readIcon();
+}
+
+void TrayItem::readIcon()
+{
+    if (isBadWindow() || m_customIcon)
+        return;
+
+    XLibUtilError error;
+    QPixmap pm = XLibUtil::getWindowIcon(m_window, &error);
+    if (checkError(error))
+        return;
+    showIcon(pm);
+}
+
+void TrayItem::iconRead(const QImage &icon)
+{
+    if (isBadWindow() || m_customIcon)
+        return;
+
+    // The worker only reads _NET_WM_ICON. WM_HINTS is small and read here.
+    if (icon.isNull()) {
+        readIconAsync();
+        return;
+    }
+    showIcon(QPixmap::fromImage(icon));
+}
+
+Task<void> TrayItem::readIconAsync()
+{
+    QPointer<TrayItem> self(this);
+    QPixmap pm = co_await XLibUtil::getWindowIconAsync(m_window);
+    // Undocked or the window went away while waiting.
+    if (!self || isBadWindow() || m_customIcon)
+        co_return;
+    showIcon(pm);
+}
+
+void TrayItem::showIcon(QPixmap pm)
+{
     if (pm.isNull())
         pm.load(":/menu/missing.png");
     m_defaultIcon = QIcon(pm);
@@ -621,18 +790,34 @@ void TrayItem::createContextMenu()
 
 bool TrayItem::isBadWindow()
 {
-    if (!XLibUtil::isValidWindowId(m_window)) {
+    return !m_alive;
+}
+
+bool TrayItem::checkError(XLibUtilError error)
+{
+    if (error != XLibUtilError::WindowError)
+        return false;
+
+    destroyEvent();
+    return true;
+}
+
+void TrayItem::windowError()
+{
+    if (!m_alive)
+        return;
+
+    // The error can be for a request made before the window was replaced or
+    // for something other than the window being gone. Make sure it's gone.
+    if (!XLibUtil::isValidWindowId(m_window))
         destroyEvent();
-        return true;
-    }
-    return false;
 }
 
 // Checks to see if the virtual desktop the window is on is currently
 // displayed. Returns true if it is, otherwise false
 bool TrayItem::isOnCurrentDesktop()
 {
-    long currentDesktop = XLibUtil::getCurrentDesktop();
+    long currentDesktop = m_registry->currentDesktop();
     if (currentDesktop == -1)
         return true;
     return (currentDesktop == m_desktop);
@@ -21,30 +21,43 @@
 #ifndef _TRAYITEM_H
 #define _TRAYITEM_H
 
+#include "task.h"
 #include "trayitemoptions.h"
 #include "trayitemsettings.h"
 #include "xlibtypes.h"
 
 #include <QAction>
+#include <QElapsedTimer>
 #include <QEvent>
+#include <QHash>
 #include <QIcon>
 #include <QMenu>
 #include <QSettings>
 #include <QString>
 #include <QSystemTrayIcon>
+#include <QTimer>
+
+class WindowRegistry;
+class XWorker;
 
 class TrayItem : public QSystemTrayIcon
 {
     Q_OBJECT
 
 public:
-    TrayItem(windowid_t window, const TrayItemOptions &config);
+    TrayItem(windowid_t window, const TrayItemOptions &config, WindowRegistry *registry, XWorker *worker);
     ~TrayItem();
 
     windowid_t dockedWindow();
 
     // Pass on all events through this interface
     bool xcbEventFilter(void *message);
+    // A request on the window failed with BadWindow.
+    void windowError();
+    // The window was destroyed. Set from DestroyNotify, or when an error
+    // on the window is confirmed with the X server, instead of asking the
+    // server before every use.
+    bool isBadWindow();
 
     void show();
     void restoreWindow();
@@ -54,6 +67,10 @@ public:
 
     QString appName();
 
+    // Results of reads requested from the worker.
+    void titleRead(const QString &title);
+    void iconRead(const QImage &icon);
+
 public slots:
     void closeWindow();
     void setSkipTaskbar(bool value);
@@ -81,6 +98,8 @@ private slots:
     void attenionMessageClicked();
 
     void doUndock();
+    // Second step of iconifyWindow.
+    void withdrawWindow();
     void doSkipPager();
     void doSticky();
 
@@ -90,30 +109,55 @@ signals:
     void undockAll();
     void undock(TrayItem *);
     void about();
+    // The window was visible again msecs after restoreWindow was called.
+    void restored(TrayItemOptions::HideStrategy strategy, qint64 msecs);
 
 protected:
     bool event(QEvent *e);
 
 private:
     void minimizeEvent();
+    // The window manager iconified the window because we asked it to.
+    void iconifyAnswered();
+    // An iconify we asked for can still be answered.
+    bool iconifyExpected();
     void destroyEvent();
     void obscureEvent();
     void focusLostEvent();
 
     void readDockedAppName();
+    // Read on the worker if it's running.
     void updateTitle();
     void updateIcon();
+    // Read on the GUI thread.
+    void readTitle();
+    void readIcon();
+    // Reads WM_HINTS without blocking. The icon is shown once it arrives.
+    Task<void> readIconAsync();
+    void showTitle(const QString &title);
+    void showIcon(QPixmap icon);
     void updateToggleAction();
 
     void createContextMenu();
     QString selectIcon(QString title);
 
-    bool isBadWindow();
+    // Returns true and marks the window destroyed if the error says it's gone.
+    bool checkError(XLibUtilError error);
     bool isOnCurrentDesktop();
 
     bool m_wantsAttention;
     bool m_iconified;
     bool m_customIcon;
+    // Iconified and waiting for the window manager before being withdrawn.
+    bool m_withdrawPending;
+    // Withdraws the window if the window manager never confirms.
+    QTimer m_withdrawTimer;
+    // Started when the window manager is asked to iconify the window. The
+    // Iconic WM_STATE and UnmapNotify it answers with aren't the user
+    // minimizing the window, even when a restore cancelled the hide.
+    QElapsedTimer m_iconifyRequested;
+    // Started by restoreWindow when the window was hidden.
+    QElapsedTimer m_restoreTimer;
 
     QIcon m_defaultIcon;
     QIcon m_attentionIcon;
@@ -124,6 +168,14 @@ private:
     XLibUtilSizeHints *m_sizeHint;
     // The window that is associated with the tray icon.
     windowid_t m_window;
+    bool m_alive;
+    // Owned by TrayItemManager. Used for the root window state.
+    WindowRegistry *m_registry;
+    // Owned by TrayItemManager. Reads the title and icon.
+    XWorker *m_worker;
+    // Events selected on m_window for us. Other parts of KDocker watch the
+    // window too so only these are removed when undocking.
+    QHash<windowid_t, quint32> m_subscription;
     long m_desktop;
     QString m_dockedAppName;
 
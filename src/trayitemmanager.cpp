@@ -25,25 +25,47 @@
 
 #include <QByteArray>
 #include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusError>
 #include <QMessageBox>
+#include <QPointer>
 #include <QTextStream>
 
 #include <xcb/xproto.h>
 
-#define ESC_key 9
+// Every event type handled by the event filter, including the ones the
+// registry handles. All core event types are below 32. Errors are type 0.
+static const quint32 HANDLED_EVENTS =
+    (1u << 0) | (1u << XCB_KEY_RELEASE) | (1u << XCB_BUTTON_PRESS) | (1u << XCB_FOCUS_OUT) |
+    (1u << XCB_VISIBILITY_NOTIFY) | (1u << XCB_DESTROY_NOTIFY) | (1u << XCB_UNMAP_NOTIFY) | (1u << XCB_MAP_NOTIFY) |
+    (1u << XCB_PROPERTY_NOTIFY);
 
-TrayItemManager::TrayItemManager() : m_scanner(this)
+TrayItemManager::TrayItemManager() : m_scanner(this, &m_registry)
 {
     m_keepRunning = false;
+    m_pendingLookups = 0;
+    m_nextManifestId = 0;
     connect(&m_scanner, &Scanner::windowFound, this, &TrayItemManager::dockWindow);
+    connect(&m_scanner, &Scanner::searchDone, this, &TrayItemManager::manifestEntryDone);
     connect(&m_scanner, &Scanner::stopping, this, &TrayItemManager::checkCount);
-    connect(this, &TrayItemManager::quitMouseGrab, &m_grabInfo, &GrabInfo::stop);
+    connect(&m_scanner, &Scanner::launchError, this, &TrayItemManager::launchFailed);
 
+    // Every atom is looked up now in one round trip instead of one at a time on first use.
+    XLibUtil::internAtoms();
     qApp->installNativeEventFilter(this);
+    m_registry.start();
+
+    connect(&m_worker, &XWorker::titleRead, this, &TrayItemManager::titleRead);
+    connect(&m_worker, &XWorker::iconRead, this, &TrayItemManager::iconRead);
+    connect(&m_worker, &XWorker::windowError, this, &TrayItemManager::workerWindowError);
+    // After the atoms are interned. The worker uses them.
+    m_worker.start();
 }
 
 TrayItemManager::~TrayItemManager()
 {
+    m_trayItemsByWindow.clear();
+    XLibUtilBatch batch;
     while (!m_trayItems.isEmpty()) {
         TrayItem *t = m_trayItems.takeFirst();
         undockRestore(t);
@@ -55,23 +77,47 @@ TrayItemManager::~TrayItemManager()
 bool TrayItemManager::nativeEventFilter([[maybe_unused]] const QByteArray &eventType, void *message,
                                         [[maybe_unused]] qintptr *result)
 {
-    static xcb_window_t dockedWindow = 0; //     zero: event ignored (default) ...
-                                          // non-zero: pass to TrayItem::xcbEventFilter
-    switch (static_cast<xcb_generic_event_t *>(message)->response_type & ~0x80) {
+    // Every event the application receives comes through here, Qt's own
+    // included. Most aren't ones we handle.
+    uint8_t type = static_cast<xcb_generic_event_t *>(message)->response_type & ~0x80;
+    if (type >= 32 || !(HANDLED_EVENTS & (1u << type)))
+        return false;
+
+    // The registry follows every window, not only docked ones.
+    m_registry.xcbEventFilter(message);
+
+    xcb_window_t dockedWindow = 0; //     zero: event ignored (default) ...
+                                   // non-zero: pass to TrayItem::xcbEventFilter
+    // Structure events use the window the event was selected on. The registry
+    // selects SubstructureNotify on the root window which reports the same
+    // events for top level windows a second time.
+    switch (type) {
+        case 0: { // Error
+            // The window was destroyed before we heard about it. Only errors
+            // for requests that weren't checked end up here.
+            xcb_generic_error_t *error = static_cast<xcb_generic_error_t *>(message);
+            if (error->error_code == XCB_WINDOW) {
+                TrayItem *item = trayItem(reinterpret_cast<xcb_window_error_t *>(error)->bad_value);
+                if (item)
+                    item->windowError();
+            }
+            return false;
+        }
+
         case XCB_FOCUS_OUT: // -> TrayItem::xcbEventFilter
             dockedWindow = static_cast<xcb_focus_out_event_t *>(message)->event;
             break;
 
         case XCB_DESTROY_NOTIFY: // -> TrayItem::xcbEventFilter
-            dockedWindow = static_cast<xcb_destroy_notify_event_t *>(message)->window;
+            dockedWindow = static_cast<xcb_destroy_notify_event_t *>(message)->event;
             break;
 
         case XCB_UNMAP_NOTIFY: // -> TrayItem::xcbEventFilter
-            dockedWindow = static_cast<xcb_unmap_notify_event_t *>(message)->window;
+            dockedWindow = static_cast<xcb_unmap_notify_event_t *>(message)->event;
             break;
 
         case XCB_MAP_NOTIFY: // -> TrayItem::xcbEventFilter
-            dockedWindow = static_cast<xcb_map_notify_event_t *>(message)->window;
+            dockedWindow = static_cast<xcb_map_notify_event_t *>(message)->event;
             break;
 
         case XCB_VISIBILITY_NOTIFY: // -> TrayItem::xcbEventFilter
@@ -82,37 +128,25 @@ bool TrayItemManager::nativeEventFilter([[maybe_unused]] const QByteArray &event
             dockedWindow = static_cast<xcb_visibility_notify_event_t *>(message)->window;
             break;
 
-        case XCB_BUTTON_PRESS:
-            if (m_grabInfo.isGrabbing()) {
-                m_grabInfo.stopGrabbing();
-
-                m_grabInfo.setButton(static_cast<xcb_button_press_event_t *>(message)->detail);
-                m_grabInfo.setWindow(static_cast<xcb_button_press_event_t *>(message)->child);
-
-                emit quitMouseGrab(); // Interrupt QTimer waiting for grab
-                return true;          // Event has been handled - don't propagate
-            }
+        case XCB_BUTTON_PRESS: {
+            xcb_button_press_event_t *event = static_cast<xcb_button_press_event_t *>(message);
+            // Event has been handled - don't propagate
+            if (m_grabInfo.buttonPressed(event->detail, event->child))
+                return true;
             break;
+        }
 
         case XCB_KEY_RELEASE:
-            if (m_grabInfo.isGrabbing()) {
-                if (static_cast<xcb_key_release_event_t *>(message)->detail == ESC_key) {
-                    m_grabInfo.stopGrabbing();
-
-                    emit quitMouseGrab(); // Interrupt QTimer waiting for grab
-                    return true;          // Event has been handled - don't propagate
-                }
-            }
+            if (m_grabInfo.keyReleased(static_cast<xcb_key_release_event_t *>(message)->detail))
+                return true;
             break;
     }
 
     if (dockedWindow) {
         // Pass on the event to the tray item with the associated window.
-        for (auto &trayItem : std::as_const(m_trayItems)) {
-            if (trayItem->dockedWindow() == static_cast<windowid_t>(dockedWindow)) {
-                return trayItem->xcbEventFilter(message);
-            }
-        }
+        TrayItem *item = trayItem(dockedWindow);
+        if (item)
+            return item->xcbEventFilter(message);
     }
 
     return false;
@@ -121,51 +155,122 @@ bool TrayItemManager::nativeEventFilter([[maybe_unused]] const QByteArray &event
 void TrayItemManager::dockWindowTitle(const QString &searchPattern, uint timeout, bool checkNormality,
                                       const TrayItemOptions &options)
 {
-    m_scanner.enqueueSearch(QRegularExpression(searchPattern), timeout, checkNormality, options);
+    m_scanner.enqueueSearch(searchPattern, timeout, checkNormality, options);
+    checkCount();
+}
+
+QList<uint> TrayItemManager::dockWindowTitle(const QString &searchPattern, bool checkNormality, bool all,
+                                             const TrayItemOptions &options)
+{
+    QList<uint> docked;
+    MatchExpression expression(searchPattern);
+    if (!expression.isValid()) {
+        QMessageBox::warning(nullptr, tr("Error"),
+                             tr("Invalid search pattern '%1': %2").arg(searchPattern).arg(expression.errorString()));
+        checkCount();
+        return docked;
+    }
+
+    QList<windowid_t> windows = m_registry.findAllWindows(expression, checkNormality, dockedWindows());
+    if (!all && windows.size() > 1)
+        windows.resize(1);
+    if (windows.isEmpty()) {
+        QMessageBox::warning(nullptr, tr("Error"), tr("Could not find a window matching for '%1'").arg(searchPattern));
+        checkCount();
+        return docked;
+    }
+
+    {
+        // Docking sends several requests for each window. They're sent
+        // together for the whole batch.
+        XLibUtilBatch batch;
+        for (windowid_t window : std::as_const(windows)) {
+            if (dockWindow(window, options))
+                docked.append(window);
+        }
+    }
     checkCount();
+    return docked;
 }
 
 void TrayItemManager::dockLaunchApp(const QString &app, const QStringList &appArguments, const QString &searchPattern,
                                     uint timeout, bool checkNormality, const TrayItemOptions &options)
 {
-    m_scanner.enqueueLaunch(app, appArguments, QRegularExpression(searchPattern), timeout, checkNormality, options);
+    LaunchRequest request;
+    request.program = app;
+    request.arguments = appArguments;
+    m_scanner.enqueueLaunch(request, searchPattern, timeout, checkNormality, options);
     checkCount();
 }
 
 bool TrayItemManager::dockWindowId(uint windowId, const TrayItemOptions &options)
 {
-    if (!XLibUtil::isValidWindowId(windowId)) {
-        QMessageBox::critical(nullptr, tr("Error"), tr("Invalid window id"));
-        checkCount();
-        return false;
-    }
-    dockWindow(windowId, options);
-    return true;
+    // Not checked up front. Docking fails if the window doesn't exist.
+    return dockWindow(windowId, options);
 }
 
 bool TrayItemManager::dockPid(int pid, bool checkNormality, const TrayItemOptions &options)
 {
-    windowid_t window = XLibUtil::pidToWid(checkNormality, pid);
-    if (!XLibUtil::isValidWindowId(window)) {
+    windowid_t window = m_registry.pidToWid(checkNormality, pid);
+    if (window != 0)
+        return dockWindow(window, options);
+
+    // The registry only has windows managed by the window manager. The rest
+    // of the tree is searched without blocking. A DBus caller gets its reply
+    // once the search finishes.
+    std::function<void(bool)> done;
+    if (calledFromDBus()) {
+        setDelayedReply(true);
+        done = [message = message(), connection = connection()](bool found) {
+            connection.send(message.createReply(found));
+        };
+    }
+    dockPidAsync(pid, checkNormality, options, done);
+    return false;
+}
+
+Task<void> TrayItemManager::dockPidAsync(int pid, bool checkNormality, TrayItemOptions options,
+                                         std::function<void(bool)> done)
+{
+    QPointer<TrayItemManager> self(this);
+    m_pendingLookups++;
+    windowid_t window = co_await XLibUtil::pidToWidAsync(checkNormality, pid);
+    if (!self) {
+        if (done)
+            done(false);
+        co_return;
+    }
+    m_pendingLookups--;
+
+    bool found = false;
+    if (window == 0) {
         QMessageBox::critical(nullptr, tr("Error"), tr("Invalid pid"));
-        checkCount();
-        return false;
+    } else {
+        found = dockWindow(window, options);
     }
-    dockWindow(window, options);
-    return true;
+    if (done)
+        done(found);
+    checkCount();
 }
 
 void TrayItemManager::dockSelectWindow(bool checkNormality, const TrayItemOptions &options)
 {
-    windowid_t window = userSelectWindow(checkNormality);
-    if (window)
-        dockWindow(window, options);
-    checkCount();
+    dockSelectWindow(checkNormality, 0, options);
+}
+
+void TrayItemManager::dockSelectWindow(bool checkNormality, uint timeout, const TrayItemOptions &options)
+{
+    userSelectWindow(checkNormality, timeout * 1000, [this, options](windowid_t window) {
+        if (window && !dockWindow(window, options))
+            window = 0;
+        emit windowSelected(window);
+        checkCount();
+    });
 }
 
 void TrayItemManager::dockFocused(const TrayItemOptions &options)
 {
-    windowid_t window = XLibUtil::getActiveWindow();
+    windowid_t window = m_registry.activeWindow();
     if (!window) {
         QMessageBox::critical(nullptr, tr("Error"), tr("Cannot dock the active window because no window has focus"));
         checkCount();
@@ -174,6 +279,137 @@ void TrayItemManager::dockFocused(const TrayItemOptions &options)
     dockWindow(window, options);
 }
 
+QString TrayItemManager::dockManifest(const QString &manifest)
+{
+    Manifest parsed;
+    QString error;
+    if (!Manifest::parse(manifest.toUtf8(), &parsed, &error)) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::InvalidArgs, tr("Invalid manifest: %1").arg(error));
+        } else {
+            QMessageBox::critical(nullptr, tr("Error"), tr("Invalid manifest: %1").arg(error));
+        }
+        checkCount();
+        return QString();
+    }
+
+    // Every entry is counted before any is queued. An entry that can't be
+    // queued finishes right away.
+    quint64 run = ++m_nextManifestId;
+    ManifestRun &manifestRun = m_manifestRuns[run];
+    manifestRun.concurrency = parsed.concurrency;
+    if (calledFromDBus()) {
+        setDelayedReply(true);
+        manifestRun.message = message();
+    }
+    for (const ManifestEntry &entry : std::as_const(parsed.entries)) {
+        manifestRun.labels.append(entry.label());
+        manifestRun.windows.append(0);
+        manifestRun.msecs.append(0);
+    }
+    manifestRun.remaining = parsed.entries.size();
+    manifestRun.timer.start();
+    updateLaunchConcurrency();
+
+    // All entries go to the scanner before it runs so they're resolved in
+    // the same passes.
+    for (qsizetype i = 0; i < parsed.entries.size(); i++) {
+        quint64 tag = ++m_nextManifestId;
+        m_manifestTags.insert(tag, qMakePair(run, i));
+        if (!enqueueManifestEntry(parsed.entries[i], tag))
+            manifestEntryDone(tag, 0);
+    }
+    checkCount();
+    return QString();
+}
+
+bool TrayItemManager::enqueueManifestEntry(const ManifestEntry &entry, quint64 tag)
+{
+    switch (entry.type) {
+        case ManifestEntry::Type::Launch: {
+            LaunchRequest request;
+            request.program = entry.command;
+            request.arguments = entry.arguments;
+            request.workingDirectory = entry.workingDirectory;
+            request.outputFile = entry.outputFile;
+            if (!entry.environment.isEmpty()) {
+                request.environment = QProcessEnvironment::systemEnvironment();
+                for (auto it = entry.environment.cbegin(); it != entry.environment.cend(); ++it) {
+                    request.environment.insert(it.key(), it.value());
+                }
+            }
+            return m_scanner.enqueueLaunch(request, entry.pattern, entry.timeout, entry.checkNormality, entry.options,
+                                           tag);
+        }
+        case ManifestEntry::Type::Title:
+            return m_scanner.enqueueSearch(entry.pattern, entry.timeout, entry.checkNormality, entry.options, tag);
+        case ManifestEntry::Type::Pid:
+            // Through the scanner instead of dockPid so pid entries share its
+            // passes and wait for windows that haven't opened yet.
+            m_scanner.enqueuePid(entry.pid, entry.timeout, entry.checkNormality, entry.options, tag);
+            return true;
+    }
+    return false;
+}
+
+void TrayItemManager::manifestEntryDone(quint64 tag, windowid_t window)
+{
+    // Only searches queued by dockManifest are tagged.
+    auto tagIt = m_manifestTags.find(tag);
+    if (tagIt == m_manifestTags.end())
+        return;
+    auto [run, index] = tagIt.value();
+    m_manifestTags.erase(tagIt);
+
+    auto it = m_manifestRuns.find(run);
+    if (it == m_manifestRuns.end())
+        return;
+    it->windows[index] = window;
+    it->msecs[index] = it->timer.elapsed();
+    if (--it->remaining > 0)
+        return;
+
+    ManifestRun finished = m_manifestRuns.take(run);
+    updateLaunchConcurrency();
+    int docked = 0;
+    for (windowid_t w : std::as_const(finished.windows)) {
+        if (w != 0)
+            docked++;
+    }
+
+    QString report;
+    QTextStream out(&report);
+    out << tr("Manifest: %1 of %2 entries docked in %3 ms")
+               .arg(docked)
+               .arg(finished.labels.size())
+               .arg(finished.timer.elapsed())
+        << Qt::endl;
+    for (qsizetype i = 0; i < finished.labels.size(); i++) {
+        QString result = finished.windows[i] != 0 ? QString("0x%1").arg(finished.windows[i], 0, 16) : tr("failed");
+        out << QString("  %1  %2  %3 ms").arg(finished.labels[i], -32).arg(result, -10).arg(finished.msecs[i], 6)
+            << Qt::endl;
+    }
+
+    if (finished.message.type() == QDBusMessage::MethodCallMessage) {
+        QDBusConnection::sessionBus().send(finished.message.createReply(report));
+    } else {
+        QTextStream(stdout) << report;
+    }
+}
+
+void TrayItemManager::updateLaunchConcurrency()
+{
+    quint64 newest = 0;
+    int concurrency = Launcher::DEFAULT_MAX_PENDING;
+    for (auto it = m_manifestRuns.cbegin(); it != m_manifestRuns.cend(); ++it) {
+        if (it->concurrency > 0 && it.key() > newest) {
+            newest = it.key();
+            concurrency = it->concurrency;
+        }
+    }
+    m_scanner.setLaunchConcurrency(concurrency);
+}
+
 WindowNameMap TrayItemManager::listWindows()
 {
     WindowNameMap items;
@@ -187,108 +423,131 @@ WindowNameMap TrayItemManager::listWindows()
 
 bool TrayItemManager::closeWindow(uint windowId)
 {
-    for (auto &trayItem : std::as_const(m_trayItems)) {
-        if (trayItem->dockedWindow() == static_cast<windowid_t>(windowId)) {
-            trayItem->closeWindow();
-            return true;
-        }
-    }
-    return false;
+    TrayItem *item = trayItem(static_cast<windowid_t>(windowId));
+    if (!item)
+        return false;
+
+    item->closeWindow();
+    return true;
 }
 
 bool TrayItemManager::hideWindow(uint windowId)
 {
-    for (auto &trayItem : std::as_const(m_trayItems)) {
-        if (trayItem->dockedWindow() == static_cast<windowid_t>(windowId)) {
-            trayItem->iconifyWindow();
-            return true;
-        }
-    }
-    return false;
+    TrayItem *item = trayItem(static_cast<windowid_t>(windowId));
+    if (!item)
+        return false;
+
+    item->iconifyWindow();
+    return true;
 }
 
 bool TrayItemManager::showWindow(uint windowId)
 {
-    for (auto &trayItem : std::as_const(m_trayItems)) {
-        if (trayItem->dockedWindow() == static_cast<windowid_t>(windowId)) {
-            trayItem->restoreWindow();
-            return true;
-        }
+    TrayItem *item = trayItem(static_cast<windowid_t>(windowId));
+    if (!item)
+        return false;
+
+    item->restoreWindow();
+    return true;
+}
+
+void TrayItemManager::hideAll()
+{
+    XLibUtilBatch batch;
+    for (TrayItem *item : std::as_const(m_trayItems)) {
+        item->iconifyWindow();
+    }
+}
+
+void TrayItemManager::showAll()
+{
+    XLibUtilBatch batch;
+    for (TrayItem *item : std::as_const(m_trayItems)) {
+        item->restoreWindow();
     }
-    return false;
 }
 
 bool TrayItemManager::undockWindow(uint windowId)
 {
-    for (size_t i = m_trayItems.count(); i-- > 0;) {
-        auto *trayItem = m_trayItems[i];
-        if (trayItem->dockedWindow() == static_cast<windowid_t>(windowId)) {
-            undockRestore(trayItem);
+    TrayItem *item = m_trayItemsByWindow.take(static_cast<windowid_t>(windowId));
+    if (!item)
+        return false;
 
-            trayItem->deleteLater();
-            m_trayItems.remove(i);
+    m_trayItems.removeOne(item);
+    undockRestore(item);
+    item->deleteLater();
 
-            checkCount();
-            return true;
-        }
-    }
-    return false;
+    checkCount();
+    return true;
 }
 
-void TrayItemManager::dockWindow(windowid_t window, const TrayItemOptions &settings)
+bool TrayItemManager::dockWindow(windowid_t window, const TrayItemOptions &settings)
 {
     if (isWindowDocked(window)) {
         QMessageBox::information(nullptr, tr("Info"), tr("This window is already docked\nClick on system tray icon to toggle docking."));
         checkCount();
-        return;
+        return true;
     }
 
-    TrayItem *ti = new TrayItem(window, settings);
+    TrayItem *ti = new TrayItem(window, settings, &m_registry, &m_worker);
+    // The window went away while it was being docked.
+    if (ti->isBadWindow()) {
+        delete ti;
+        QMessageBox::critical(nullptr, tr("Error"), tr("Invalid window id"));
+        checkCount();
+        return false;
+    }
 
     connect(ti, &TrayItem::selectAnother, this, &TrayItemManager::selectAndIconify);
     connect(ti, &TrayItem::dead, this, &TrayItemManager::remove);
     connect(ti, &TrayItem::undock, this, &TrayItemManager::remove);
     connect(ti, &TrayItem::undockAll, this, &TrayItemManager::undockAll);
     connect(ti, &TrayItem::about, this, &TrayItemManager::about);
+    connect(ti, &TrayItem::restored, this, &TrayItemManager::recordRestore);
 
     ti->show();
 
     m_trayItems.append(ti);
+    m_trayItemsByWindow.insert(window, ti);
+    return true;
 }
 
-windowid_t TrayItemManager::userSelectWindow(bool checkNormality)
+void TrayItemManager::userSelectWindow(bool checkNormality, int timeout, std::function<void(windowid_t)> callback)
 {
     QTextStream out(stdout);
-    out << tr("Select the application/window to dock with the left mouse button.") << Qt::endl;
-    out << tr("Click any other mouse button to abort.") << Qt::endl;
-
-    QString error;
-    windowid_t window = XLibUtil::selectWindow(m_grabInfo, error);
-    if (!window) {
-        if (error != QString()) {
-            QMessageBox::critical(nullptr, tr("Error"), error);
+    if (m_grabInfo.pending() > 0)
+        out << tr("Waiting for the current window selection to finish.") << Qt::endl;
+    m_grabInfo.select(timeout, [this, checkNormality, callback](windowid_t window, const QString &error) {
+        if (!window) {
+            if (error != QString()) {
+                QMessageBox::critical(nullptr, tr("Error"), error);
+            }
+            callback(0);
+            return;
         }
-        checkCount();
-        return 0;
-    }
 
-    if (checkNormality) {
-        if (!XLibUtil::isNormalWindow(window)) {
-            auto ret = QMessageBox::warning(nullptr, tr("Warning"), tr("The window you are attempting to dock does not seem to be a normal window"),
-                QMessageBox::Abort | QMessageBox::Ignore, QMessageBox::Abort);
-            if (ret == QMessageBox::Abort) {
-                checkCount();
-                return 0;
+        if (checkNormality) {
+            if (!XLibUtil::isNormalWindow(window)) {
+                auto ret = QMessageBox::warning(nullptr, tr("Warning"), tr("The window you are attempting to dock does not seem to be a normal window"),
+                    QMessageBox::Abort | QMessageBox::Ignore, QMessageBox::Abort);
+                if (ret == QMessageBox::Abort) {
+                    callback(0);
+                    return;
+                }
             }
         }
-    }
 
-    return window;
+        callback(window);
+    });
+
+    out << tr("Select the application/window to dock with the left mouse button.") << Qt::endl;
+    out << tr("Click any other mouse button to abort.") << Qt::endl;
 }
 
 void TrayItemManager::remove(TrayItem *trayItem)
 {
     m_trayItems.removeAll(trayItem);
+    m_trayItemsByWindow.remove(trayItem->dockedWindow());
     trayItem->deleteLater();
 
     checkCount();
@@ -303,10 +562,16 @@ void TrayItemManager::undockRestore(TrayItem *trayItem)
 
 void TrayItemManager::undockAll()
 {
-    while (!m_trayItems.isEmpty()) {
-        TrayItem *t = m_trayItems.takeFirst();
-        undockRestore(t);
-        t->deleteLater();
+    m_trayItemsByWindow.clear();
+    {
+        // Every window is restored with one flush at the end instead of
+        // one for each window.
+        XLibUtilBatch batch;
+        while (!m_trayItems.isEmpty()) {
+            TrayItem *t = m_trayItems.takeFirst();
+            undockRestore(t);
+            t->deleteLater();
+        }
     }
 
     checkCount();
@@ -322,15 +587,61 @@ void TrayItemManager::keepRunning()
     m_keepRunning = true;
 }
 
+qulonglong TrayItemManager::errorCount()
+{
+    return XLibUtil::unhandledErrorCount();
+}
+
+RestoreLatencyMap TrayItemManager::restoreLatency()
+{
+    RestoreLatencyMap latency;
+    for (auto it = m_restoreTimes.cbegin(); it != m_restoreTimes.cend(); ++it) {
+        latency.insert(it.key(), static_cast<uint>(it.value().total / it.value().count));
+    }
+    return latency;
+}
+
+void TrayItemManager::titleRead(windowid_t window, const QString &title)
+{
+    TrayItem *item = trayItem(window);
+    if (item)
+        item->titleRead(title);
+}
+
+void TrayItemManager::iconRead(windowid_t window, const QImage &icon)
+{
+    TrayItem *item = trayItem(window);
+    if (item)
+        item->iconRead(icon);
+}
+
+void TrayItemManager::workerWindowError(windowid_t window)
+{
+    TrayItem *item = trayItem(window);
+    if (item)
+        item->windowError();
+}
+
+void TrayItemManager::recordRestore(TrayItemOptions::HideStrategy strategy, qint64 msecs)
+{
+    RestoreTimes &times = m_restoreTimes[TrayItemOptions::hideStrategyName(strategy)];
+    times.total += msecs;
+    times.count++;
+}
+
 void TrayItemManager::selectAndIconify()
 {
-    windowid_t window = userSelectWindow(true);
-    if (window)
-        dockWindow(window, TrayItemOptions());
+    userSelectWindow(true, GrabInfo::DEFAULT_TIMEOUT, [this](windowid_t window) {
+        if (window)
+            dockWindow(window, TrayItemOptions());
+        checkCount();
+    });
 }
 
 void TrayItemManager::quit()
 {
+    // Releases the grab. The callbacks see nothing selected.
+    m_grabInfo.cancelAll();
     undockAll();
     qApp->quit();
 }
@@ -340,7 +651,8 @@ void TrayItemManager::checkCount()
     if (m_keepRunning)
         return;
 
-    if (m_trayItems.isEmpty() && !m_scanner.isRunning())
+    if (m_trayItems.isEmpty() && !m_scanner.isRunning() && m_pendingLookups == 0 &&
+        m_grabInfo.pending() == 0)
         qApp->quit();
 }
 
@@ -357,10 +669,10 @@ QList<windowid_t> TrayItemManager::dockedWindows()
 
 bool TrayItemManager::isWindowDocked(windowid_t window)
 {
-    for (auto &trayItem : std::as_const(m_trayItems)) {
-        if (trayItem->dockedWindow() == window) {
-            return true;
-        }
-    }
-    return false;
+    return m_trayItemsByWindow.contains(window);
+}
+
+TrayItem *TrayItemManager::trayItem(windowid_t window)
+{
+    return m_trayItemsByWindow.value(window, nullptr);
 }
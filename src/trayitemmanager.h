@@ -24,17 +24,28 @@
 #include "adaptor.h"
 #include "command.h"
 #include "grabinfo.h"
+#include "manifest.h"
 #include "scanner.h"
+#include "task.h"
 #include "trayitem.h"
+#include "windowregistry.h"
 #include "xlibtypes.h"
+#include "xworker.h"
 
+#include <QDBusContext>
+#include <QDBusMessage>
+#include <QElapsedTimer>
 #include <QHash>
 #include <QList>
+#include <QMap>
 #include <QObject>
+#include <QPair>
 #include <QStringList>
 #include <QtCore/QAbstractNativeEventFilter>
 
-class TrayItemManager : public QObject, public QAbstractNativeEventFilter
+#include <functional>
+
+class TrayItemManager : public QObject, public QAbstractNativeEventFilter, protected QDBusContext
 {
     Q_OBJECT
 
@@ -51,44 +62,113 @@ public slots:
     // the full ones. The defaults allow us to have one function for each overload.
     void dockWindowTitle(const QString &searchPattern, uint timeout = 4, bool checkNormality = true,
                          const TrayItemOptions &options = TrayItemOptions());
+    // Docks the windows matching now instead of waiting for one to appear.
+    // Every match when all is set, otherwise the oldest. Returns the docked windows.
+    QList<uint> dockWindowTitle(const QString &searchPattern, bool checkNormality, bool all,
+                                const TrayItemOptions &options);
     void dockLaunchApp(const QString &app, const QStringList &appArguments, const QString &searchPattern,
                        uint timeout = 4, bool checkNormality = true,
                        const TrayItemOptions &options = TrayItemOptions());
     bool dockWindowId(uint windowId, const TrayItemOptions &options = TrayItemOptions());
     bool dockPid(int pid, bool checkNormality = true, const TrayItemOptions &options = TrayItemOptions());
     void dockSelectWindow(bool checkNormality = true, const TrayItemOptions &options = TrayItemOptions());
+    // timeout is in seconds. 0 uses the default. Returns right away.
+    // windowSelected is emitted once the selection finishes.
+    void dockSelectWindow(bool checkNormality, uint timeout, const TrayItemOptions &options);
     void dockFocused(const TrayItemOptions &options = TrayItemOptions());
+    // Docks every entry of a manifest. See Manifest for the format. A report
+    // of each entry's time is made once they've all finished. A DBus caller
+    // gets it as the reply, otherwise it's printed.
+    QString dockManifest(const QString &manifest);
 
     WindowNameMap listWindows();
     bool closeWindow(uint windowId);
     bool hideWindow(uint windowId);
     bool showWindow(uint windowId);
     bool undockWindow(uint windowId);
+    void hideAll();
+    void showAll();
     void undockAll();
 
     void quit();
     void keepRunning();
 
+    qulonglong errorCount();
+    RestoreLatencyMap restoreLatency();
+
 private slots:
-    void dockWindow(windowid_t window, const TrayItemOptions &settings);
-    windowid_t userSelectWindow(bool checkNormality = true);
+    // Returns false if the window doesn't exist.
+    bool dockWindow(windowid_t window, const TrayItemOptions &settings);
     void remove(TrayItem *trayItem);
     void undockRestore(TrayItem *trayItem);
     void selectAndIconify();
     void about();
+    void recordRestore(TrayItemOptions::HideStrategy strategy, qint64 msecs);
+    void titleRead(windowid_t window, const QString &title);
+    void iconRead(windowid_t window, const QImage &icon);
+    void workerWindowError(windowid_t window);
+    void manifestEntryDone(quint64 tag, windowid_t window);
 
     void checkCount();
 
 signals:
-    void quitMouseGrab();
+    // A selection started by dockSelectWindow finished. windowId is the docked
+    // window or 0 when nothing was selected or it couldn't be docked.
+    void windowSelected(uint windowId);
+    // A launch from dockLaunchApp or a manifest couldn't be started.
+    void launchFailed(const QString &command, const QString &error);
 
 private:
     bool isWindowDocked(windowid_t window);
+    TrayItem *trayItem(windowid_t window);
+    // Queues a selection. callback gets 0 when nothing suitable was selected.
+    void userSelectWindow(bool checkNormality, int timeout, std::function<void(windowid_t)> callback);
+    // Searches every window for pid and docks it once found. done, if set, gets
+    // whether a window was docked.
+    Task<void> dockPidAsync(int pid, bool checkNormality, TrayItemOptions options, std::function<void(bool)> done);
+    // Queues a manifest entry with the scanner. Returns false if it couldn't be queued.
+    bool enqueueManifestEntry(const ManifestEntry &entry, quint64 tag);
+    // The newest running manifest's concurrency applies to launches. The
+    // launcher's default once none of them set one.
+    void updateLaunchConcurrency();
 
+    // Declared before the scanner which uses it.
+    WindowRegistry m_registry;
+    XWorker m_worker;
     Scanner m_scanner;
+    // Docked order is kept in the list. The hash finds the item for a window.
     QList<TrayItem *> m_trayItems;
+    QHash<windowid_t, TrayItem *> m_trayItemsByWindow;
     GrabInfo m_grabInfo;
     bool m_keepRunning;
+    // pid searches that haven't finished.
+    int m_pendingLookups;
+    // Time taken for restored windows to be visible again by hide strategy name.
+    struct RestoreTimes
+    {
+        qint64 total = 0;
+        uint count = 0;
+    };
+    QMap<QString, RestoreTimes> m_restoreTimes;
+    // Manifests with entries still being searched for.
+    struct ManifestRun
+    {
+        QStringList labels;
+        // 0 for entries that failed or haven't finished.
+        QList<windowid_t> windows;
+        QList<qint64> msecs;
+        int remaining = 0;
+        // 0 leaves the limit of the runs before it.
+        int concurrency = 0;
+        QElapsedTimer timer;
+        // The DBus call waiting for the report. Empty when it's printed.
+        QDBusMessage message;
+    };
+    QHash<quint64, ManifestRun> m_manifestRuns;
+    // Scanner tag to the run and entry index.
+    QHash<quint64, QPair<quint64, qsizetype>> m_manifestTags;
+    // Runs and tags are numbered from the same counter.
+    quint64 m_nextManifestId;
 };
 
 #endif // _TRAYITEMMANAGER_H
@@ -33,13 +33,14 @@ static const QString DKEY_STICKY = "sticky";
 static const QString DKEY_SKTASK = "skip-taskbar";
 static const QString DKEY_LOCKDESK = "lock-to-desktop";
 static const QString DKEY_ICONDCKNG = "iconify-docking";
+static const QString DKEY_HIDESTRAT = "hide-strategy";
 
 TrayItemOptions::TrayItemOptions()
     : m_iconifyFocusLost(TrayItemOptions::TriState::Unset), m_iconifyMinimized(TrayItemOptions::TriState::Unset),
       m_iconifyObscured(TrayItemOptions::TriState::Unset), m_notifyTime(-1), m_quiet(TrayItemOptions::TriState::Unset),
       m_skipPager(TrayItemOptions::TriState::Unset), m_sticky(TrayItemOptions::TriState::Unset),
       m_skipTaskbar(TrayItemOptions::TriState::Unset), m_lockToDesktop(TrayItemOptions::TriState::Unset),
-      m_iconifyDocking(TrayItemOptions::TriState::Unset)
+      m_iconifyDocking(TrayItemOptions::TriState::Unset), m_hideStrategy(TrayItemOptions::HideStrategy::Unset)
 {}
 
 TrayItemOptions::TrayItemOptions(const TrayItemOptions &other)
@@ -56,6 +57,7 @@ TrayItemOptions::TrayItemOptions(const TrayItemOptions &other)
     m_skipTaskbar = other.m_skipTaskbar;
     m_lockToDesktop = other.m_lockToDesktop;
     m_iconifyDocking = other.m_iconifyDocking;
+    m_hideStrategy = other.m_hideStrategy;
 }
 
 TrayItemOptions &TrayItemOptions::operator=(const TrayItemOptions &other)
@@ -75,6 +77,7 @@ TrayItemOptions &TrayItemOptions::operator=(const TrayItemOptions &other)
     m_skipTaskbar = other.m_skipTaskbar;
     m_lockToDesktop = other.m_lockToDesktop;
     m_iconifyDocking = other.m_iconifyDocking;
+    m_hideStrategy = other.m_hideStrategy;
     return *this;
 }
 
@@ -157,6 +160,12 @@ QDBusArgument &operator<<(QDBusArgument &argument, const TrayItemOptions &option
         argument.endMapEntry();
     }
 
+    if (options.m_hideStrategy != TrayItemOptions::HideStrategy::Unset) {
+        argument.beginMapEntry();
+        argument << DKEY_HIDESTRAT << TrayItemOptions::hideStrategyName(options.m_hideStrategy);
+        argument.endMapEntry();
+    }
+
     argument.endMap();
     return argument;
 }
@@ -173,47 +182,54 @@ const QDBusArgument &operator>>(const QDBusArgument &argument, TrayItemOptions &
         argument >> key >> val;
         argument.endMapEntry();
 
-        if (QString::compare(key, DKEY_ICONP, Qt::CaseInsensitive) == 0) {
-            options.m_iconPath = val;
-        } else if (QString::compare(key, DKEY_AICOP, Qt::CaseInsensitive) == 0) {
-            options.m_attentionIconPath = val;
-        } else if (QString::compare(key, DKEY_ICONFFOC, Qt::CaseInsensitive) == 0) {
-            options.m_iconifyFocusLost =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_ICONFMIN, Qt::CaseInsensitive) == 0) {
-            options.m_iconifyMinimized =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_ICONFOBS, Qt::CaseInsensitive) == 0) {
-            options.m_iconifyObscured =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_NOTIFYT, Qt::CaseInsensitive) == 0) {
-            bool ok;
-            options.m_notifyTime = val.toInt(&ok) * 1000;
-        } else if (QString::compare(key, DKEY_QUIET, Qt::CaseInsensitive) == 0) {
-            options.m_quiet =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_SKPAG, Qt::CaseInsensitive) == 0) {
-            options.m_skipPager =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_STICKY, Qt::CaseInsensitive) == 0) {
-            options.m_sticky =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_SKTASK, Qt::CaseInsensitive) == 0) {
-            options.m_skipTaskbar =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_LOCKDESK, Qt::CaseInsensitive) == 0) {
-            options.m_lockToDesktop =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        } else if (QString::compare(key, DKEY_ICONDCKNG, Qt::CaseInsensitive) == 0) {
-            options.m_iconifyDocking =
-                QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
-        }
+        options.setOption(key, val);
     }
 
     argument.endMap();
     return argument;
 }
 
+bool TrayItemOptions::setOption(const QString &key, const QString &val)
+{
+    if (QString::compare(key, DKEY_ICONP, Qt::CaseInsensitive) == 0) {
+        m_iconPath = val;
+    } else if (QString::compare(key, DKEY_AICOP, Qt::CaseInsensitive) == 0) {
+        m_attentionIconPath = val;
+    } else if (QString::compare(key, DKEY_ICONFFOC, Qt::CaseInsensitive) == 0) {
+        m_iconifyFocusLost =
+            QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_ICONFMIN, Qt::CaseInsensitive) == 0) {
+        m_iconifyMinimized =
+            QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_ICONFOBS, Qt::CaseInsensitive) == 0) {
+        m_iconifyObscured =
+            QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_NOTIFYT, Qt::CaseInsensitive) == 0) {
+        bool ok;
+        m_notifyTime = val.toInt(&ok) * 1000;
+    } else if (QString::compare(key, DKEY_QUIET, Qt::CaseInsensitive) == 0) {
+        m_quiet = QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_SKPAG, Qt::CaseInsensitive) == 0) {
+        m_skipPager = QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_STICKY, Qt::CaseInsensitive) == 0) {
+        m_sticky = QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_SKTASK, Qt::CaseInsensitive) == 0) {
+        m_skipTaskbar =
+            QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_LOCKDESK, Qt::CaseInsensitive) == 0) {
+        m_lockToDesktop =
+            QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_ICONDCKNG, Qt::CaseInsensitive) == 0) {
+        m_iconifyDocking =
+            QVariant(val).toBool() ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
+    } else if (QString::compare(key, DKEY_HIDESTRAT, Qt::CaseInsensitive) == 0) {
+        m_hideStrategy = TrayItemOptions::hideStrategyFromName(val);
+    } else {
+        return false;
+    }
+    return true;
+}
+
 QString TrayItemOptions::getIconPath() const
 {
     return m_iconPath;
@@ -274,6 +290,11 @@ TrayItemOptions::TriState TrayItemOptions::getIconifyDockingState() const
     return m_iconifyDocking;
 }
 
+TrayItemOptions::HideStrategy TrayItemOptions::getHideStrategyState() const
+{
+    return m_hideStrategy;
+}
+
 bool TrayItemOptions::getIconifyFocusLost() const
 {
     switch (m_iconifyFocusLost) {
@@ -396,6 +417,13 @@ bool TrayItemOptions::getIconifyDocking() const
     return false;
 }
 
+TrayItemOptions::HideStrategy TrayItemOptions::getHideStrategy() const
+{
+    if (m_hideStrategy == TrayItemOptions::HideStrategy::Unset)
+        return defaultHideStrategy();
+    return m_hideStrategy;
+}
+
 void TrayItemOptions::setIconPath(const QString &v)
 {
     m_iconPath = v;
@@ -456,6 +484,11 @@ void TrayItemOptions::setIconifyDocking(TrayItemOptions::TriState v)
     m_iconifyDocking = v;
 }
 
+void TrayItemOptions::setHideStrategy(TrayItemOptions::HideStrategy v)
+{
+    m_hideStrategy = v;
+}
+
 void TrayItemOptions::setIconifyFocusLost(bool v)
 {
     m_iconifyFocusLost = v ? TrayItemOptions::TriState::SetTrue : TrayItemOptions::TriState::SetFalse;
@@ -560,3 +593,34 @@ bool TrayItemOptions::defaultIconifyDocking()
 {
     return true;
 }
+
+TrayItemOptions::HideStrategy TrayItemOptions::defaultHideStrategy()
+{
+    return TrayItemOptions::HideStrategy::Withdraw;
+}
+
+QString TrayItemOptions::hideStrategyName(TrayItemOptions::HideStrategy v)
+{
+    switch (v) {
+        case TrayItemOptions::HideStrategy::Withdraw:
+            return "withdraw";
+        case TrayItemOptions::HideStrategy::Iconic:
+            return "iconic";
+        case TrayItemOptions::HideStrategy::Unmap:
+            return "unmap";
+        case TrayItemOptions::HideStrategy::Unset:
+            break;
+    }
+    return QString();
+}
+
+TrayItemOptions::HideStrategy TrayItemOptions::hideStrategyFromName(const QString &name)
+{
+    for (TrayItemOptions::HideStrategy v :
+         {TrayItemOptions::HideStrategy::Withdraw, TrayItemOptions::HideStrategy::Iconic,
+          TrayItemOptions::HideStrategy::Unmap}) {
+        if (QString::compare(name, hideStrategyName(v), Qt::CaseInsensitive) == 0)
+            return v;
+    }
+    return TrayItemOptions::HideStrategy::Unset;
+}
@@ -33,6 +33,18 @@ public:
         SetFalse = false
     };
 
+    // How a window is hidden when it's iconified to the tray.
+    enum class HideStrategy
+    {
+        Unset = -1,
+        // Iconify then withdraw. Removed from the taskbar with every window manager.
+        Withdraw,
+        // Iconify (ICCCM WM_CHANGE_STATE) only.
+        Iconic,
+        // Unmap the window without iconifying it first.
+        Unmap
+    };
+
     TrayItemOptions();
     ~TrayItemOptions() {};
     TrayItemOptions(const TrayItemOptions &other);
@@ -41,6 +53,9 @@ public:
     friend QDBusArgument &operator<<(QDBusArgument &argument, const TrayItemOptions &options);
     friend const QDBusArgument &operator>>(const QDBusArgument &argument, TrayItemOptions &options);
 
+    // Sets an option by its windowConfig key. Returns false for an unknown key.
+    bool setOption(const QString &key, const QString &val);
+
     QString getIconPath() const;
     QString getAttentionIconPath() const;
     bool getNotifyTimeState() const;
@@ -54,6 +69,7 @@ public:
     TrayItemOptions::TriState getSkipTaskbarState() const;
     TrayItemOptions::TriState getLockToDesktopState() const;
     TrayItemOptions::TriState getIconifyDockingState() const;
+    TrayItemOptions::HideStrategy getHideStrategyState() const;
 
     bool getIconifyFocusLost() const;
     bool getIconifyMinimized() const;
@@ -65,6 +81,7 @@ public:
     bool getSkipTaskbar() const;
     bool getLockToDesktop() const;
     bool getIconifyDocking() const;
+    TrayItemOptions::HideStrategy getHideStrategy() const;
 
     void setIconPath(const QString &v);
     void setAttentionIconPath(const QString &v);
@@ -77,6 +94,7 @@ public:
     void setSkipTaskbar(TrayItemOptions::TriState v);
     void setLockToDesktop(TrayItemOptions::TriState v);
     void setIconifyDocking(TrayItemOptions::TriState v);
+    void setHideStrategy(TrayItemOptions::HideStrategy v);
 
     void setIconifyFocusLost(bool v);
     void setIconifyMinimized(bool v);
@@ -101,6 +119,12 @@ public:
     static bool defaultSkipTaskbar();
     static bool defaultLockToDesktop();
     static bool defaultIconifyDocking();
+    static TrayItemOptions::HideStrategy defaultHideStrategy();
+
+    // Names used for the strategy in settings, DBus and on the command line.
+    static QString hideStrategyName(TrayItemOptions::HideStrategy v);
+    // Unset if the name isn't known.
+    static TrayItemOptions::HideStrategy hideStrategyFromName(const QString &name);
 
 private:
     QString m_iconPath;
@@ -115,6 +139,7 @@ private:
     TrayItemOptions::TriState m_skipTaskbar;
     TrayItemOptions::TriState m_lockToDesktop;
     TrayItemOptions::TriState m_iconifyDocking;
+    TrayItemOptions::HideStrategy m_hideStrategy;
 };
 
 Q_DECLARE_METATYPE(TrayItemOptions)
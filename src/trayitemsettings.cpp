@@ -69,6 +69,7 @@ void TrayItemSettings::loadSettingsDefault()
     setSkipTaskbar(defaultSkipTaskbar());
     setLockToDesktop(defaultLockToDesktop());
     setIconifyDocking(defaultIconifyDocking());
+    setHideStrategy(defaultHideStrategy());
 }
 
 void TrayItemSettings::loadSettingsSection()
@@ -123,6 +124,13 @@ void TrayItemSettings::loadSettingsSection()
     val = m_settings.value("IconifyDocking");
     if (val.isValid())
         setIconifyDocking(val.toBool());
+
+    val = m_settings.value("HideStrategy");
+    if (val.isValid()) {
+        TrayItemOptions::HideStrategy strategy = hideStrategyFromName(val.toString());
+        if (strategy != TrayItemOptions::HideStrategy::Unset)
+            setHideStrategy(strategy);
+    }
 }
 
 void TrayItemSettings::loadSettingsGlobal()
@@ -193,6 +201,10 @@ void TrayItemSettings::loadSettingsOptions(const TrayItemOptions &options)
     tri = options.getQuietState();
     if (tri != TrayItemOptions::TriState::Unset)
         setQuiet(tri);
+
+    TrayItemOptions::HideStrategy strategy = options.getHideStrategyState();
+    if (strategy != TrayItemOptions::HideStrategy::Unset)
+        setHideStrategy(strategy);
 }
 
 void TrayItemSettings::saveSettingsSection()
@@ -208,6 +220,7 @@ void TrayItemSettings::saveSettingsSection()
     m_settings.setValue("IconifyFocusLost", getIconifyFocusLost());
     m_settings.setValue("LockToDesktop", getLockToDesktop());
     m_settings.setValue("IconifyDocking", getIconifyDocking());
+    m_settings.setValue("HideStrategy", hideStrategyName(getHideStrategy()));
 }
 
 void TrayItemSettings::saveSettingsApp()
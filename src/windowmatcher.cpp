@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "windowmatcher.h"
+
+// Characters that have a meaning in a regular expression. A pattern without
+// any of them only matches itself.
+static bool isLiteral(const QString &pattern)
+{
+    static const QString special("\\^$.|?*+()[]{}");
+    for (QChar c : pattern) {
+        if (special.contains(c))
+            return false;
+    }
+    return true;
+}
+
+WindowMatcher::WindowMatcher() : m_mode(Mode::Regex) {}
+
+WindowMatcher::WindowMatcher(const QRegularExpression &pattern) : m_pattern(pattern), m_mode(Mode::Regex)
+{
+    QString text = pattern.pattern();
+    // Pattern options, such as case insensitivity, need the regular expression.
+    bool plain = pattern.patternOptions() == QRegularExpression::NoPatternOption;
+    if (plain && isLiteral(text)) {
+        m_mode = Mode::Contains;
+        m_literal = text.toUtf8();
+    } else if (plain && text.size() > 2 && text.startsWith('^') && text.endsWith('$') &&
+               isLiteral(text.mid(1, text.size() - 2))) {
+        m_mode = Mode::Exact;
+        m_literal = text.mid(1, text.size() - 2).toUtf8();
+    }
+
+    if (m_mode == Mode::Contains) {
+        m_matcher.setPattern(m_literal);
+    } else if (m_mode == Mode::Regex) {
+        // Compile now instead of on the first match.
+        m_pattern.optimize();
+    }
+}
+
+const QRegularExpression &WindowMatcher::pattern() const
+{
+    return m_pattern;
+}
+
+bool WindowMatcher::matches(const QByteArray &utf8, const QString &text) const
+{
+    switch (m_mode) {
+        case Mode::Contains:
+            return m_matcher.indexIn(utf8) != -1;
+        case Mode::Exact:
+            // $ also matches before a trailing newline.
+            return utf8 == m_literal || (utf8.size() == m_literal.size() + 1 && utf8.endsWith('\n') &&
+                                         utf8.startsWith(m_literal));
+        case Mode::Regex:
+            break;
+    }
+    return m_pattern.match(text).hasMatch();
+}
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _WINDOWMATCHER_H
+#define _WINDOWMATCHER_H
+
+#include <QByteArray>
+#include <QByteArrayMatcher>
+#include <QRegularExpression>
+#include <QString>
+
+// Matches a window property against a search pattern. Built once per search
+// and cheap to copy.
+//
+// Patterns without any regular expression syntax, such as a plain class name,
+// are searched for directly in the UTF-8 bytes read from X. Anything else is
+// handed to the regular expression which is compiled when the matcher is built.
+class WindowMatcher
+{
+public:
+    WindowMatcher();
+    explicit WindowMatcher(const QRegularExpression &pattern);
+
+    const QRegularExpression &pattern() const;
+    // utf8 and text are the same value. The bytes as read and decoded.
+    bool matches(const QByteArray &utf8, const QString &text) const;
+
+private:
+    enum class Mode
+    {
+        Regex,
+        Contains,
+        Exact
+    };
+
+    QRegularExpression m_pattern;
+    Mode m_mode;
+    QByteArray m_literal;
+    QByteArrayMatcher m_matcher;
+};
+
+#endif // _WINDOWMATCHER_H
@@ -0,0 +1,459 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "windowregistry.h"
+
+#include <QTimer>
+
+#include <xcb/xproto.h>
+
+WindowRegistry::WindowRegistry()
+    : m_started(false), m_haveClientList(false), m_clientListChanged(false), m_updateQueued(false), m_root(0),
+      m_clientListAtom(0), m_rootStateDirty(true), m_rootChangeExpected(false)
+{}
+
+WindowRegistry::~WindowRegistry()
+{
+    if (m_started)
+        XLibUtil::unSubscribe(m_addedMasks);
+}
+
+void WindowRegistry::start()
+{
+    if (m_started)
+        return;
+    m_started = true;
+
+    m_root = XLibUtil::getRootWindow();
+    const XLibUtilAtoms &atoms = XLibUtil::atoms();
+    m_clientListAtom = atoms._NET_CLIENT_LIST;
+    m_watchedAtoms = {atoms.WM_NAME,          atoms._NET_WM_NAME,        atoms.WM_CLASS,
+                      atoms._NET_WM_PID,      atoms.WM_STATE,            atoms._NET_WM_STATE,
+                      atoms.WM_TRANSIENT_FOR, atoms._NET_WM_WINDOW_TYPE, atoms._NET_WM_DESKTOP,
+                      atoms.WM_WINDOW_ROLE,   atoms._NET_STARTUP_ID};
+    m_rootAtoms = {atoms._NET_CURRENT_DESKTOP, atoms._NET_NUMBER_OF_DESKTOPS, atoms._NET_ACTIVE_WINDOW,
+                   atoms._NET_CLIENT_LIST_STACKING};
+
+    // Subscribe before reading the windows so changes made in between aren't missed.
+    m_addedMasks = XLibUtil::subscribeNewWindows();
+
+    QList<windowid_t> clients;
+    m_haveClientList = XLibUtil::getClientWindows(&clients);
+    if (m_haveClientList) {
+        addWindows(clients, false);
+    } else {
+        for (windowid_t window : XLibUtil::getTopLevelWindows()) {
+            m_mapped.insert(window);
+        }
+        // Only windows the window manager is managing. Windows that are mapped
+        // later are followed even without a window manager.
+        resolveMapped(true);
+    }
+    // Nobody is waiting on the windows that were already there.
+    m_changed.clear();
+}
+
+bool WindowRegistry::xcbEventFilter(void *message)
+{
+    if (!m_started)
+        return false;
+
+    xcb_generic_event_t *event = static_cast<xcb_generic_event_t *>(message);
+    switch (event->response_type & ~0x80) {
+        case XCB_MAP_NOTIFY: {
+            // With a client list new windows are found when they're added to it.
+            xcb_map_notify_event_t *map = reinterpret_cast<xcb_map_notify_event_t *>(event);
+            if (!m_haveClientList && map->event == m_root && !map->override_redirect) {
+                m_mapped.insert(map->window);
+                queueUpdate();
+            }
+            break;
+        }
+
+        case XCB_UNMAP_NOTIFY:
+            expectRootChange();
+            break;
+
+        case XCB_DESTROY_NOTIFY: {
+            xcb_destroy_notify_event_t *destroy = reinterpret_cast<xcb_destroy_notify_event_t *>(event);
+            if (destroy->event == m_root) {
+                m_mapped.remove(destroy->window);
+                // Nothing to unsubscribe from. The windows are gone.
+                windowid_t client = m_frames.take(destroy->window);
+                removeWindow(client);
+                m_addedMasks.remove(client);
+                removeWindow(destroy->window);
+                m_addedMasks.remove(destroy->window);
+            }
+            break;
+        }
+
+        case XCB_PROPERTY_NOTIFY: {
+            xcb_property_notify_event_t *property = reinterpret_cast<xcb_property_notify_event_t *>(event);
+            if (property->window == m_root) {
+                if (property->atom == m_clientListAtom) {
+                    m_clientListChanged = true;
+                    queueUpdate();
+                } else if (m_rootAtoms.contains(property->atom)) {
+                    m_rootStateDirty = true;
+                }
+                break;
+            }
+
+            if (property->atom == XLibUtil::atoms().WM_STATE)
+                expectRootChange();
+            if (m_windows.contains(property->window) && m_watchedAtoms.contains(property->atom)) {
+                m_dirty.insert(property->window);
+                queueUpdate();
+            }
+            break;
+        }
+    }
+
+    return false;
+}
+
+long WindowRegistry::currentDesktop()
+{
+    return rootState().currentDesktop;
+}
+
+long WindowRegistry::desktopCount()
+{
+    return rootState().desktopCount;
+}
+
+windowid_t WindowRegistry::activeWindow()
+{
+    const XLibUtilRootState &state = rootState();
+    // Without _NET_ACTIVE_WINDOW, or when the window manager cleared it, the
+    // window with the input focus is used.
+    if (!state.hasActiveWindow || state.activeWindow == 0)
+        return XLibUtil::getInputFocus();
+    return state.activeWindow;
+}
+
+QList<windowid_t> WindowRegistry::stacking()
+{
+    return rootState().stacking;
+}
+
+QList<windowid_t> WindowRegistry::windows()
+{
+    update();
+    return m_order;
+}
+
+bool WindowRegistry::contains(windowid_t window)
+{
+    update();
+    return m_windows.contains(window);
+}
+
+XLibUtilWindowInfo WindowRegistry::info(windowid_t window)
+{
+    update();
+    return m_windows.value(window);
+}
+
+QList<windowid_t> WindowRegistry::windowsForPid(pid_t pid)
+{
+    update();
+    return m_byPid.values(pid);
+}
+
+QList<windowid_t> WindowRegistry::windowsForClass(const QString &resClass)
+{
+    update();
+    return m_byClass.values(resClass);
+}
+
+windowid_t WindowRegistry::pidToWid(bool checkNormality, pid_t pid)
+{
+    update();
+
+    // A process can have multiple windows. Prefer the oldest like a search
+    // of the client list would.
+    windowid_t found = 0;
+    qsizetype foundIndex = -1;
+    for (windowid_t window : m_byPid.values(pid)) {
+        if (checkNormality && !m_windows.value(window).normal)
+            continue;
+
+        qsizetype index = m_order.indexOf(window);
+        if (found == 0 || index < foundIndex) {
+            found = window;
+            foundIndex = index;
+        }
+    }
+    return found;
+}
+
+QList<windowid_t> WindowRegistry::findWindows(const QList<XLibUtilWindowSearch> &searches,
+                                              const QList<windowid_t> &dockedWindows)
+{
+    update();
+    return findWindows(searches, m_order, dockedWindows);
+}
+
+QList<windowid_t> WindowRegistry::findWindows(const QList<XLibUtilWindowSearch> &searches,
+                                              const QList<windowid_t> &candidates,
+                                              const QList<windowid_t> &dockedWindows)
+{
+    update();
+
+    QList<XLibUtilWindowInfo> infos;
+    for (windowid_t window : candidates) {
+        auto it = m_windows.constFind(window);
+        if (it != m_windows.constEnd()) {
+            infos.append(it.value());
+        }
+    }
+
+    QList<windowid_t> found(searches.size(), 0);
+    XLibUtil::matchWindows(searches, infos, dockedWindows, &found);
+    return found;
+}
+
+QList<windowid_t> WindowRegistry::findAllWindows(const MatchExpression &expression, bool checkNormality,
+                                                 const QList<windowid_t> &dockedWindows)
+{
+    update();
+
+    QSet<windowid_t> docked(dockedWindows.cbegin(), dockedWindows.cend());
+    QList<windowid_t> found;
+    for (windowid_t window : std::as_const(m_order)) {
+        auto it = m_windows.constFind(window);
+        if (it == m_windows.constEnd() || docked.contains(window))
+            continue;
+        if (checkNormality && !it.value().normal)
+            continue;
+        if (expression.matches(it.value()))
+            found.append(window);
+    }
+    return found;
+}
+
+void WindowRegistry::queueUpdate()
+{
+    // Events come in bursts. Read everything that changed once control
+    // returns to the event loop instead of from within the event filter.
+    if (m_updateQueued)
+        return;
+    m_updateQueued = true;
+    QTimer::singleShot(0, this, &WindowRegistry::processChanges);
+}
+
+void WindowRegistry::processChanges()
+{
+    m_updateQueued = false;
+    m_rootChangeExpected = false;
+    update();
+
+    QList<windowid_t> changed;
+    for (windowid_t window : std::as_const(m_changed)) {
+        if (m_windows.contains(window) && !changed.contains(window)) {
+            changed.append(window);
+        }
+    }
+    m_changed.clear();
+
+    if (!changed.isEmpty())
+        emit windowsChanged(changed);
+}
+
+void WindowRegistry::update()
+{
+    if (m_clientListChanged) {
+        m_clientListChanged = false;
+        updateClientList();
+    }
+
+    if (!m_mapped.isEmpty())
+        resolveMapped(false);
+
+    if (!m_dirty.isEmpty()) {
+        QList<windowid_t> dirty = m_dirty.values();
+        m_dirty.clear();
+        refreshWindows(dirty);
+    }
+}
+
+void WindowRegistry::updateClientList()
+{
+    QList<windowid_t> clients;
+    m_haveClientList = XLibUtil::getClientWindows(&clients);
+    // The window manager went away. Keep what we have until windows are destroyed.
+    if (!m_haveClientList)
+        return;
+
+    QSet<windowid_t> current(clients.begin(), clients.end());
+    QList<windowid_t> removed;
+    for (windowid_t window : QList<windowid_t>(m_order)) {
+        if (!current.contains(window)) {
+            removeWindow(window);
+            removed.append(window);
+        }
+    }
+    // Withdrawn windows still exist. The events added to them are removed.
+    unsubscribe(removed);
+
+    QList<windowid_t> added;
+    for (windowid_t window : std::as_const(clients)) {
+        if (!m_windows.contains(window)) {
+            added.append(window);
+        }
+    }
+    addWindows(added, false);
+}
+
+void WindowRegistry::resolveMapped(bool managedOnly)
+{
+    QList<windowid_t> clients;
+    for (windowid_t window : std::as_const(m_mapped)) {
+        // The top level window can be a window manager frame. The application's
+        // window is within the frame.
+        windowid_t client = XLibUtil::getClientWindow(window);
+        m_frames.insert(window, client);
+        if (!m_windows.contains(client)) {
+            clients.append(client);
+        }
+    }
+    m_mapped.clear();
+
+    addWindows(clients, managedOnly);
+}
+
+void WindowRegistry::addWindows(const QList<windowid_t> &windows, bool managedOnly)
+{
+    if (windows.isEmpty())
+        return;
+
+    // Watch before reading so changes made after the read aren't missed.
+    QHash<windowid_t, quint32> added = XLibUtil::subscribeProperties(windows);
+    for (auto it = added.cbegin(); it != added.cend(); ++it) {
+        m_addedMasks[it.key()] |= it.value();
+    }
+
+    QList<windowid_t> skipped;
+    for (const XLibUtilWindowInfo &info : XLibUtil::getWindowInfo(windows)) {
+        if (managedOnly && info.wmState == -1) {
+            skipped.append(info.window);
+            continue;
+        }
+
+        m_windows.insert(info.window, info);
+        m_order.append(info.window);
+        index(info);
+        m_changed.append(info.window);
+    }
+    unsubscribe(skipped);
+}
+
+void WindowRegistry::refreshWindows(const QList<windowid_t> &windows)
+{
+    for (const XLibUtilWindowInfo &info : XLibUtil::getWindowInfo(windows)) {
+        auto it = m_windows.find(info.window);
+        // Removed while waiting to be read.
+        if (it == m_windows.end())
+            continue;
+
+        unindex(it.value());
+        it.value() = info;
+        index(info);
+        m_changed.append(info.window);
+    }
+}
+
+void WindowRegistry::removeWindow(windowid_t window)
+{
+    if (window == 0)
+        return;
+
+    auto it = m_windows.find(window);
+    if (it != m_windows.end()) {
+        unindex(it.value());
+        m_windows.erase(it);
+        m_order.removeOne(window);
+    }
+    m_dirty.remove(window);
+}
+
+void WindowRegistry::unsubscribe(const QList<windowid_t> &windows)
+{
+    // Docked windows keep the events until they're released. The tray item
+    // relies on them and didn't select the ones the registry already had.
+    QHash<windowid_t, quint32> masks;
+    for (windowid_t window : windows) {
+        if (!m_held.contains(window) && m_addedMasks.contains(window))
+            masks.insert(window, m_addedMasks.take(window));
+    }
+    if (!masks.isEmpty())
+        XLibUtil::unSubscribe(masks);
+}
+
+void WindowRegistry::hold(windowid_t window)
+{
+    m_held.insert(window);
+}
+
+void WindowRegistry::release(windowid_t window)
+{
+    if (!m_held.remove(window))
+        return;
+    // Still listed by the window manager. Removed along with the window.
+    if (!m_windows.contains(window))
+        unsubscribe({window});
+}
+
+const XLibUtilRootState &WindowRegistry::rootState()
+{
+    if (m_rootStateDirty) {
+        m_rootStateDirty = false;
+        m_rootState = XLibUtil::getRootState();
+    }
+    return m_rootState;
+}
+
+void WindowRegistry::expectRootChange()
+{
+    // Window managers can update the root window after the windows they
+    // change. KWin unmaps windows before it sets the new current desktop.
+    // Read the root state again, once for the whole burst of events, so
+    // the state seen while handling them is current.
+    if (m_rootChangeExpected)
+        return;
+    m_rootChangeExpected = true;
+    m_rootStateDirty = true;
+    queueUpdate();
+}
+
+void WindowRegistry::index(const XLibUtilWindowInfo &info)
+{
+    if (info.pid != -1)
+        m_byPid.insert(info.pid, info.window);
+    if (info.hasClass)
+        m_byClass.insert(info.resClass, info.window);
+}
+
+void WindowRegistry::unindex(const XLibUtilWindowInfo &info)
+{
+    m_byPid.remove(info.pid, info.window);
+    m_byClass.remove(info.resClass, info.window);
+}
@@ -0,0 +1,148 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _WINDOWREGISTRY_H
+#define _WINDOWREGISTRY_H
+
+#include "xlibtypes.h"
+#include "xlibutil.h"
+
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+// Mirrors the top level windows managed by the window manager along with the
+// properties used to find them. The registry is kept current from X events so
+// lookups are answered from memory instead of querying the X server.
+//
+// Windows are taken from _NET_CLIENT_LIST. If the window manager doesn't
+// publish the list, top level windows are followed as they're mapped.
+//
+// The window manager's state on the root window (current desktop, active
+// window, etc.) is mirrored the same way.
+//
+// Events only mark what changed. Changes are read from the server in one batch
+// once control returns to the event loop, or before the next lookup if that
+// comes first.
+class WindowRegistry : public QObject
+{
+    Q_OBJECT
+
+public:
+    WindowRegistry();
+    ~WindowRegistry();
+
+    // Subscribe to the root window and read the current windows.
+    void start();
+    // Pass on all events through this interface. Events are never consumed.
+    bool xcbEventFilter(void *message);
+
+    QList<windowid_t> windows();
+    bool contains(windowid_t window);
+    XLibUtilWindowInfo info(windowid_t window);
+    QList<windowid_t> windowsForPid(pid_t pid);
+    QList<windowid_t> windowsForClass(const QString &resClass);
+
+    // Root window state. Read once after it changes instead of on every call.
+    long currentDesktop();
+    long desktopCount();
+    windowid_t activeWindow();
+    QList<windowid_t> stacking();
+
+    // Same as the XLibUtil functions but only windows in the registry are looked at.
+    windowid_t pidToWid(bool checkNormality, pid_t pid);
+    QList<windowid_t> findWindows(const QList<XLibUtilWindowSearch> &searches, const QList<windowid_t> &dockedWindows);
+    QList<windowid_t> findWindows(const QList<XLibUtilWindowSearch> &searches, const QList<windowid_t> &candidates,
+                                  const QList<windowid_t> &dockedWindows);
+    // Every window matching expression, oldest first, in one pass over the
+    // registry. Windows in dockedWindows are skipped.
+    QList<windowid_t> findAllWindows(const MatchExpression &expression, bool checkNormality,
+                                     const QList<windowid_t> &dockedWindows);
+
+    // A docked window keeps the events the registry selected on it while
+    // it's held, even after it leaves the registry.
+    void hold(windowid_t window);
+    void release(windowid_t window);
+
+signals:
+    // Windows that were added or had a property change.
+    void windowsChanged(const QList<windowid_t> &windows);
+
+private slots:
+    void processChanges();
+
+private:
+    void update();
+    void queueUpdate();
+    void updateClientList();
+    void resolveMapped(bool managedOnly);
+    // managedOnly skips windows without a WM_STATE.
+    void addWindows(const QList<windowid_t> &windows, bool managedOnly);
+    void refreshWindows(const QList<windowid_t> &windows);
+    void removeWindow(windowid_t window);
+    // Removes the events the registry added to windows that aren't held.
+    void unsubscribe(const QList<windowid_t> &windows);
+    const XLibUtilRootState &rootState();
+    void expectRootChange();
+    void index(const XLibUtilWindowInfo &info);
+    void unindex(const XLibUtilWindowInfo &info);
+
+    bool m_started;
+    // The window manager publishes _NET_CLIENT_LIST.
+    bool m_haveClientList;
+    bool m_clientListChanged;
+    bool m_updateQueued;
+    windowid_t m_root;
+    atom_t m_clientListAtom;
+    // Properties kept in XLibUtilWindowInfo.
+    QSet<atom_t> m_watchedAtoms;
+    // Root window properties kept in m_rootState.
+    QSet<atom_t> m_rootAtoms;
+
+    XLibUtilRootState m_rootState;
+    bool m_rootStateDirty;
+    // The root state was already marked to be read again for the events
+    // being processed.
+    bool m_rootChangeExpected;
+
+    // Oldest window first.
+    QList<windowid_t> m_order;
+    QHash<windowid_t, XLibUtilWindowInfo> m_windows;
+    QMultiHash<pid_t, windowid_t> m_byPid;
+    QMultiHash<QString, windowid_t> m_byClass;
+
+    // Windows with properties that need to be read again.
+    QSet<windowid_t> m_dirty;
+    // Without a client list. Top level windows that were mapped and need
+    // the client window within them found. Followed by the client window
+    // within each top level window.
+    QSet<windowid_t> m_mapped;
+    QHash<windowid_t, windowid_t> m_frames;
+    // Windows to report with windowsChanged.
+    QList<windowid_t> m_changed;
+    // Events we added to each window.
+    QHash<windowid_t, quint32> m_addedMasks;
+    // Docked windows. See hold.
+    QSet<windowid_t> m_held;
+};
+
+#endif // _WINDOWREGISTRY_H
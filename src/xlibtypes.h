@@ -20,8 +20,14 @@
 #ifndef _XLIBTYPES
 #define _XLIBTYPES
 
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
 #include <QtGlobal>
 
+#include <sys/types.h>
+
 // Types we use with XLibUtil to represent X11 types we can't / don't want
 // to expose. See details on XLibUtil class about why. These are not a
 // redefinition. Instead these are our types that can hold the X11 type's
@@ -31,15 +37,142 @@
 
 typedef quint32 atom_t;
 
+// Every atom KDocker uses. They're interned together in a single round trip
+// by XLibUtil::internAtoms. Add new atoms here instead of looking them up
+// where they're used.
+#define XLIBUTIL_ATOMS(X)                                                                                              \
+    X(WM_CLASS)                                                                                                        \
+    X(WM_ICON)                                                                                                         \
+    X(WM_NAME)                                                                                                         \
+    X(WM_STATE)                                                                                                        \
+    X(WM_TRANSIENT_FOR)                                                                                                \
+    X(WM_WINDOW_ROLE)                                                                                                  \
+    X(_NET_ACTIVE_WINDOW)                                                                                              \
+    X(_NET_CLIENT_LIST)                                                                                                \
+    X(_NET_CLIENT_LIST_STACKING)                                                                                       \
+    X(_NET_CLOSE_WINDOW)                                                                                               \
+    X(_NET_CURRENT_DESKTOP)                                                                                            \
+    X(_NET_NUMBER_OF_DESKTOPS)                                                                                         \
+    X(_NET_WM_DESKTOP)                                                                                                 \
+    X(_NET_WM_ICON)                                                                                                    \
+    X(_NET_WM_NAME)                                                                                                    \
+    X(_NET_WM_PID)                                                                                                     \
+    X(_NET_STARTUP_ID)                                                                                                 \
+    X(_NET_WM_STATE)                                                                                                   \
+    X(_NET_WM_STATE_MODAL)                                                                                             \
+    X(_NET_WM_STATE_SKIP_PAGER)                                                                                        \
+    X(_NET_WM_STATE_SKIP_TASKBAR)                                                                                      \
+    X(_NET_WM_STATE_STICKY)                                                                                            \
+    X(_NET_WM_WINDOW_TYPE)                                                                                             \
+    X(_NET_WM_WINDOW_TYPE_DIALOG)                                                                                      \
+    X(_NET_WM_WINDOW_TYPE_NORMAL)
+
+// The value of each atom in XLIBUTIL_ATOMS. Members are named after the atom.
+struct XLibUtilAtoms
+{
+#define XLIBUTIL_ATOM_MEMBER(name) atom_t name = 0;
+    XLIBUTIL_ATOMS(XLIBUTIL_ATOM_MEMBER)
+#undef XLIBUTIL_ATOM_MEMBER
+};
+
 // X11 defines `Window` as an `unsigned long` which is often 64 bit but not
 // always. However, xcb defines it as a `uint32_t`. The documentation isn't
 // fully clear but it's safe to assume windows will always be within the range
 // of an unsigned 32 bit integer.
 typedef quint32 windowid_t;
 
+// Errors reported by XLibUtil functions that take an error argument. Not
+// named after the X11 error codes because those are defines.
+enum class XLibUtilError
+{
+    NoError,
+    // BadWindow. The window doesn't exist, usually because it was destroyed.
+    WindowError,
+    // BadAtom
+    AtomError,
+    OtherError
+};
+
 // Hiding XSizeHints. X11 uses a typdef'ed anonymous struct
 // so we can't forward declare the type. Instead we'll define
 // it as void and use pointers. Not ideal but it will work.
 typedef void XLibUtilSizeHints;
 
+// Properties of a top level window used to find and describe it.
+// Read with XLibUtil::getWindowInfo. Properties that weren't read keep
+// their defaults.
+struct XLibUtilWindowInfo
+{
+    // Groups of properties that can be read.
+    enum Field : quint32
+    {
+        Pid = 0x01,
+        Class = 0x02,
+        Name = 0x04,
+        Title = 0x08,
+        Role = 0x10,
+        State = 0x20,
+        Desktop = 0x40,
+        StartupId = 0x80,
+        All = 0xFF
+    };
+
+    windowid_t window = 0;
+    // _NET_WM_PID or -1 when the window doesn't have one.
+    pid_t pid = -1;
+    bool hasName = false;
+    bool hasClass = false;
+    // WM_CLASS
+    QString resName;
+    QString resClass;
+    // WM_NAME
+    QString name;
+    // _NET_WM_NAME falling back to WM_NAME.
+    QString title;
+    // WM_WINDOW_ROLE
+    QString role;
+    // The same as read from X. Searches match on these where they can.
+    QByteArray resNameUtf8;
+    QByteArray resClassUtf8;
+    QByteArray nameUtf8;
+    QByteArray titleUtf8;
+    QByteArray roleUtf8;
+    // The state in WM_STATE or -1 when the window doesn't have one.
+    int wmState = -1;
+    QList<atom_t> windowType;
+    long desktop = 0;
+    // _NET_STARTUP_ID. The DESKTOP_STARTUP_ID the app was launched with.
+    QByteArray startupId;
+    // See XLibUtil::isNormalWindow.
+    bool normal = false;
+};
+
+// Window manager state published on the root window. Read with
+// XLibUtil::getRootState.
+struct XLibUtilRootState
+{
+    // _NET_CURRENT_DESKTOP or -1 when the window manager doesn't set it.
+    long currentDesktop = -1;
+    // _NET_NUMBER_OF_DESKTOPS or 0 when the window manager doesn't set it.
+    long desktopCount = 0;
+    // _NET_ACTIVE_WINDOW. 0 when no window is active.
+    bool hasActiveWindow = false;
+    windowid_t activeWindow = 0;
+    // _NET_CLIENT_LIST_STACKING. Bottom most window first.
+    QList<windowid_t> stacking;
+};
+
+// Pointer and key grabs made by XLibUtil::grabSelection. Released with
+// XLibUtil::ungrabSelection.
+struct XLibUtilGrab
+{
+    bool active = false;
+    // Cursor shown while selecting.
+    quint32 cursor = 0;
+    // Escape key code.
+    quint8 escapeKey = 0;
+    // Events added to the root window for the grab.
+    QHash<windowid_t, quint32> addedMask;
+};
+
 #endif // _XLIBTYPES
@@ -22,14 +22,25 @@
 
 #include <QGuiApplication>
 #include <QImage>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <atomic>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/cursorfont.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+#ifdef HAVE_XRES
+#include <X11/extensions/XRes.h>
+#endif
 
 #define BIT0 (1 << 0)
 #define BIT1 (1 << 1)
@@ -43,13 +54,195 @@
 // and all X11 lib functions are static. So this works fine even
 // though it's more c than cpp. But X11 is a c library.
 //
-// Most functions that look up Atom's will store the result in
-// a function local static variable. This is an optimization so
-// we don't have to keep calling a string lookup function. Atoms
-// are unsigned longs and never change their value.
+// Atoms are interned once, all together, at startup and read from
+// XLibUtil::atoms(). Looking an atom up by name is a round trip to the
+// server. Atoms never change their value.
+//
+// Window properties are read using xcb instead of Xlib. Xlib's
+// XGetWindowProperty sends a request and then blocks waiting for the
+// reply before the next request can be sent. xcb lets us send any
+// number of requests up front and collect the replies afterwards.
+// Reading several properties costs one round trip instead of one per
+// property. Which matters a lot on high latency connections (remote X,
+// Xpra, etc.).
+
+// X errors that weren't returned to anyone. Atomic because requests made
+// on the XWorker thread can count errors too.
+static std::atomic<quint64> unhandledErrors = 0;
+
+// Errors from requests that are checked are returned to the caller when it
+// asks for them. Otherwise they're only counted.
+static void setError(xcb_generic_error_t *xerror, XLibUtilError *error)
+{
+    XLibUtilError code = XLibUtilError::NoError;
+    if (xerror != nullptr) {
+        switch (xerror->error_code) {
+            case XCB_WINDOW:
+                code = XLibUtilError::WindowError;
+                break;
+            case XCB_ATOM:
+                code = XLibUtilError::AtomError;
+                break;
+            default:
+                code = XLibUtilError::OtherError;
+                break;
+        }
+        free(xerror);
+    }
+
+    if (error != nullptr) {
+        *error = code;
+    } else if (code != XLibUtilError::NoError) {
+        unhandledErrors++;
+    }
+}
 
-static int ignoreXErrors([[maybe_unused]] Display *, [[maybe_unused]] XErrorEvent *)
+// Length to request when we want the entire property value. The server
+// will only send what is actually there.
+static const uint32_t PROPERTY_LENGTH_ALL = UINT32_MAX;
+
+// Owns a GetProperty reply and frees it when it goes out of scope.
+class XcbPropertyReply
 {
+public:
+    XcbPropertyReply() : m_reply(nullptr) {}
+    explicit XcbPropertyReply(xcb_get_property_reply_t *reply) : m_reply(reply) {}
+    XcbPropertyReply(XcbPropertyReply &&other) : m_reply(other.m_reply)
+    {
+        other.m_reply = nullptr;
+    }
+    XcbPropertyReply(const XcbPropertyReply &) = delete;
+    XcbPropertyReply &operator=(const XcbPropertyReply &) = delete;
+    ~XcbPropertyReply()
+    {
+        free(m_reply);
+    }
+
+    // The property exists on the window.
+    bool exists() const
+    {
+        return m_reply != nullptr && m_reply->type != XCB_ATOM_NONE;
+    }
+
+    xcb_atom_t type() const
+    {
+        return m_reply ? m_reply->type : XCB_ATOM_NONE;
+    }
+
+    uint8_t format() const
+    {
+        return m_reply ? m_reply->format : 0;
+    }
+
+    // Number of items in the value. Each item is format bits wide.
+    uint32_t count() const
+    {
+        return m_reply ? m_reply->value_len : 0;
+    }
+
+    const uint8_t *bytes() const
+    {
+        if (!exists() || m_reply->format != 8)
+            return nullptr;
+        return static_cast<const uint8_t *>(xcb_get_property_value(m_reply));
+    }
+
+    // Format 32 values are always 32 bit with xcb. Unlike Xlib which
+    // expands them to longs.
+    const uint32_t *values32() const
+    {
+        if (!exists() || m_reply->format != 32)
+            return nullptr;
+        return static_cast<const uint32_t *>(xcb_get_property_value(m_reply));
+    }
+
+    // Returns the first value of a format 32 property.
+    bool value32(uint32_t *value) const
+    {
+        const uint32_t *v = values32();
+        if (v == nullptr || count() == 0)
+            return false;
+        *value = v[0];
+        return true;
+    }
+
+    bool contains32(uint32_t value) const
+    {
+        const uint32_t *v = values32();
+        if (v == nullptr)
+            return false;
+        for (uint32_t i = 0; i < count(); i++) {
+            if (v[i] == value)
+                return true;
+        }
+        return false;
+    }
+
+    // The value of a format 8 property (string types).
+    QByteArray toByteArray() const
+    {
+        const uint8_t *b = bytes();
+        if (b == nullptr)
+            return QByteArray();
+        return QByteArray(reinterpret_cast<const char *>(b), count());
+    }
+
+private:
+    xcb_get_property_reply_t *m_reply;
+};
+
+// Collects GetProperty requests. Each request is sent as soon as it's added
+// but the replies are only waited on when they're taken. Taking the first
+// reply waits for the server, after that the rest of the replies will have
+// already arrived. Any number of properties, across any number of windows,
+// can be read with a single round trip.
+class XcbPropertyBatch
+{
+public:
+    explicit XcbPropertyBatch(xcb_connection_t *connection) : m_connection(connection) {}
+    XcbPropertyBatch(const XcbPropertyBatch &) = delete;
+    XcbPropertyBatch &operator=(const XcbPropertyBatch &) = delete;
+    ~XcbPropertyBatch()
+    {
+        // Replies that were never taken still need to be released.
+        for (const xcb_get_property_cookie_t &cookie : std::as_const(m_cookies)) {
+            if (cookie.sequence != 0)
+                xcb_discard_reply(m_connection, cookie.sequence);
+        }
+    }
+
+    // Returns an id that's used to take the reply.
+    int add(xcb_window_t window, xcb_atom_t property, xcb_atom_t type = XCB_ATOM_ANY,
+            uint32_t length = PROPERTY_LENGTH_ALL)
+    {
+        m_cookies.append(xcb_get_property(m_connection, false, window, property, type, 0, length));
+        return m_cookies.size() - 1;
+    }
+
+    // A reply can only be taken once. The error the request caused, if
+    // any, is set in error.
+    XcbPropertyReply take(int id, XLibUtilError *error = nullptr)
+    {
+        if (error != nullptr)
+            *error = XLibUtilError::NoError;
+        if (id < 0 || id >= m_cookies.size() || m_cookies[id].sequence == 0)
+            return XcbPropertyReply();
+
+        xcb_generic_error_t *xerror = nullptr;
+        xcb_get_property_reply_t *reply = xcb_get_property_reply(m_connection, m_cookies[id], &xerror);
+        m_cookies[id].sequence = 0;
+        setError(xerror, error);
+        return XcbPropertyReply(reply);
+    }
+
+private:
+    xcb_connection_t *m_connection;
+    QList<xcb_get_property_cookie_t> m_cookies;
+};
+
+static int countXErrors([[maybe_unused]] Display *, [[maybe_unused]] XErrorEvent *)
+{
+    unhandledErrors++;
     return 0;
 }
 
@@ -58,14 +251,71 @@ static Display *getDisplay()
     return qApp->nativeInterface<QNativeInterface::QX11Application>()->display();
 }
 
+static xcb_connection_t *getConnection()
+{
+    return qApp->nativeInterface<QNativeInterface::QX11Application>()->connection();
+}
+
+QByteArray XLibUtil::getDisplayName()
+{
+    return QByteArray(DisplayString(getDisplay()));
+}
+
 static windowid_t getDefaultRootWindow()
 {
     return DefaultRootWindow(getDisplay());
 }
 
-void XLibUtil::silenceXErrors()
+static XLibUtilAtoms internedAtoms;
+static bool atomsInterned = false;
+
+void XLibUtil::internAtoms()
+{
+    if (atomsInterned)
+        return;
+    atomsInterned = true;
+
+    static const char *const names[] = {
+#define XLIBUTIL_ATOM_NAME(name) #name,
+        XLIBUTIL_ATOMS(XLIBUTIL_ATOM_NAME)
+#undef XLIBUTIL_ATOM_NAME
+    };
+    static const size_t count = sizeof(names) / sizeof(names[0]);
+
+    // Every request is sent before any reply is waited on.
+    xcb_connection_t *connection = getConnection();
+    xcb_intern_atom_cookie_t cookies[count];
+    for (size_t i = 0; i < count; i++) {
+        cookies[i] = xcb_intern_atom(connection, false, strlen(names[i]), names[i]);
+    }
+
+    atom_t values[count];
+    for (size_t i = 0; i < count; i++) {
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, cookies[i], nullptr);
+        values[i] = reply ? reply->atom : XCB_ATOM_NONE;
+        free(reply);
+    }
+
+    size_t i = 0;
+#define XLIBUTIL_ATOM_VALUE(name) internedAtoms.name = values[i++];
+    XLIBUTIL_ATOMS(XLIBUTIL_ATOM_VALUE)
+#undef XLIBUTIL_ATOM_VALUE
+}
+
+const XLibUtilAtoms &XLibUtil::atoms()
+{
+    internAtoms();
+    return internedAtoms;
+}
+
+void XLibUtil::installErrorHandler()
 {
-    XSetErrorHandler(ignoreXErrors);
+    XSetErrorHandler(countXErrors);
+}
+
+quint64 XLibUtil::unhandledErrorCount()
+{
+    return unhandledErrors;
 }
 
 XLibUtilSizeHints *XLibUtil::newSizeHints()
@@ -98,10 +348,37 @@ void XLibUtil::setWMSizeHints(windowid_t window, XLibUtilSizeHints *sh)
 
 bool XLibUtil::isValidWindowId(windowid_t window)
 {
-    XWindowAttributes attrib;
     // Check if we can get the window's attributes. If we can't that
-    // indicates the window isn't valid.
-    return (XGetWindowAttributes(getDisplay(), window, &attrib) != 0);
+    // indicates the window isn't valid. The error is returned to us
+    // instead of going to the error handler.
+    xcb_connection_t *connection = getConnection();
+    xcb_generic_error_t *xerror = nullptr;
+    free(xcb_get_window_attributes_reply(connection, xcb_get_window_attributes(connection, window), &xerror));
+
+    XLibUtilError error;
+    setError(xerror, &error);
+    return error != XLibUtilError::WindowError;
+}
+
+// Properties needed to determine if a window is a normal window.
+struct NormalityRequest
+{
+    int wmState;
+    int windowState;
+    int transientFor;
+    int windowType;
+};
+
+static NormalityRequest requestNormality(XcbPropertyBatch &batch, xcb_window_t window)
+{
+    const XLibUtilAtoms &atoms = XLibUtil::atoms();
+
+    NormalityRequest request;
+    request.wmState = batch.add(window, atoms.WM_STATE, XCB_ATOM_ANY, 10);
+    request.windowState = batch.add(window, atoms._NET_WM_STATE, XCB_ATOM_ANY, 10);
+    request.transientFor = batch.add(window, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 1);
+    request.windowType = batch.add(window, atoms._NET_WM_WINDOW_TYPE, XCB_ATOM_ANY, 10);
+    return request;
 }
 
 // Checks if this window is a normal window (i.e)
@@ -109,217 +386,454 @@ bool XLibUtil::isValidWindowId(windowid_t window)
 // - Not modal window
 // - Not a purely transient window (with no window type set)
 // - Not a special window (desktop/menu/util) as indicated in the window type
-bool XLibUtil::isNormalWindow(windowid_t window)
+static bool isNormalWindow(const XcbPropertyReply &wmState, const XcbPropertyReply &windowState,
+                           const XcbPropertyReply &transientFor, const XcbPropertyReply &windowType)
 {
-    Atom type;
-    int format;
-    unsigned long left;
-    Atom *data = NULL;
-    unsigned long nitems;
-    Window transient_for = 0;
-    Display *display = getDisplay();
+    const XLibUtilAtoms &atoms = XLibUtil::atoms();
 
-    static Atom wmState = XInternAtom(display, "WM_STATE", false);
-    static Atom windowState = XInternAtom(display, "_NET_WM_STATE", false);
-    static Atom modalWindow = XInternAtom(display, "_NET_WM_STATE_MODAL", false);
-    static Atom windowType = XInternAtom(display, "_NET_WM_WINDOW_TYPE", false);
-    static Atom normalWindow = XInternAtom(display, "_NET_WM_WINDOW_TYPE_NORMAL", false);
-    static Atom dialogWindow = XInternAtom(display, "_NET_WM_WINDOW_TYPE_DIALOG", false);
-
-    int ret = XGetWindowProperty(display, window, wmState, 0, 10, false, AnyPropertyType, &type, &format, &nitems,
-                                 &left, (unsigned char **)&data);
+    if (!wmState.exists())
+        return false;
 
-    if (ret != Success || data == NULL) {
-        if (data != NULL)
-            XFree(data);
+    if (windowState.contains32(atoms._NET_WM_STATE_MODAL))
         return false;
-    }
-    if (data) {
-        XFree(data);
-    }
 
-    ret = XGetWindowProperty(display, window, windowState, 0, 10, false, AnyPropertyType, &type, &format, &nitems,
-                             &left, (unsigned char **)&data);
-    if (ret == Success) {
-        unsigned int i;
-        for (i = 0; i < nitems; i++) {
-            if (data[i] == modalWindow) {
-                break;
+    const uint32_t *types = windowType.values32();
+    if (types != nullptr) {
+        for (uint32_t i = 0; i < windowType.count(); i++) {
+            if (types[i] != atoms._NET_WM_WINDOW_TYPE_NORMAL && types[i] != atoms._NET_WM_WINDOW_TYPE_DIALOG) {
+                return false;
             }
         }
-        XFree(data);
-        if (i < nitems) {
-            return false;
-        }
+        return true;
     }
 
-    XGetTransientForHint(display, window, &transient_for);
+    uint32_t transient = 0;
+    transientFor.value32(&transient);
+    return (transient == 0);
+}
 
-    ret = XGetWindowProperty(display, window, windowType, 0, 10, false, AnyPropertyType, &type, &format, &nitems, &left,
-                             (unsigned char **)&data);
+bool XLibUtil::isNormalWindow(windowid_t window)
+{
+    XcbPropertyBatch batch(getConnection());
+    NormalityRequest request = requestNormality(batch, window);
+    // Every reply is taken so none are left waiting in the batch.
+    XcbPropertyReply wmState = batch.take(request.wmState);
+    XcbPropertyReply windowState = batch.take(request.windowState);
+    XcbPropertyReply transientFor = batch.take(request.transientFor);
+    XcbPropertyReply windowType = batch.take(request.windowType);
+    return ::isNormalWindow(wmState, windowState, transientFor, windowType);
+}
 
-    if ((ret == Success) && data) {
-        unsigned int i;
-        for (i = 0; i < nitems; i++) {
-            if (data[i] != normalWindow && data[i] != dialogWindow) {
-                break;
+// Desktop numbers are CARDINALs but 0xFFFFFFFF means all desktops
+// and is treated as -1.
+static long toDesktop(uint32_t value)
+{
+    return static_cast<long>(static_cast<int32_t>(value));
+}
+
+QList<XLibUtilWindowInfo> XLibUtil::getWindowInfo(const QList<windowid_t> &windows, quint32 fields)
+{
+    const XLibUtilAtoms &atoms = XLibUtil::atoms();
+
+    // Ids of properties that aren't requested stay -1. Taking them gives an
+    // empty reply.
+    struct InfoRequest
+    {
+        int pid = -1;
+        int windowClass = -1;
+        int name = -1;
+        int netName = -1;
+        int role = -1;
+        int desktop = -1;
+        int startupId = -1;
+        NormalityRequest normality = {-1, -1, -1, -1};
+    };
+
+    // All requests are sent before any reply is waited on so this is a single
+    // round trip regardless of how many windows there are.
+    XcbPropertyBatch batch(getConnection());
+    QList<InfoRequest> requests;
+    requests.reserve(windows.size());
+    for (windowid_t window : windows) {
+        InfoRequest request;
+        if (fields & XLibUtilWindowInfo::Pid)
+            request.pid = batch.add(window, atoms._NET_WM_PID, XCB_ATOM_CARDINAL, 1);
+        if (fields & XLibUtilWindowInfo::Class)
+            request.windowClass = batch.add(window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING);
+        // WM_NAME is the fallback for the title.
+        if (fields & (XLibUtilWindowInfo::Name | XLibUtilWindowInfo::Title))
+            request.name = batch.add(window, XCB_ATOM_WM_NAME);
+        if (fields & XLibUtilWindowInfo::Title)
+            request.netName = batch.add(window, atoms._NET_WM_NAME);
+        if (fields & XLibUtilWindowInfo::Role)
+            request.role = batch.add(window, atoms.WM_WINDOW_ROLE, XCB_ATOM_STRING);
+        if (fields & XLibUtilWindowInfo::Desktop)
+            request.desktop = batch.add(window, atoms._NET_WM_DESKTOP, XCB_ATOM_CARDINAL, 1);
+        if (fields & XLibUtilWindowInfo::StartupId)
+            request.startupId = batch.add(window, atoms._NET_STARTUP_ID);
+        if (fields & XLibUtilWindowInfo::State)
+            request.normality = requestNormality(batch, window);
+        requests.append(request);
+    }
+
+    QList<XLibUtilWindowInfo> infos;
+    infos.reserve(windows.size());
+    for (int i = 0; i < windows.size(); i++) {
+        const InfoRequest &request = requests[i];
+        XLibUtilWindowInfo info;
+        info.window = windows[i];
+
+        uint32_t pid;
+        if (batch.take(request.pid).value32(&pid))
+            info.pid = static_cast<pid_t>(pid);
+
+        XcbPropertyReply windowClass = batch.take(request.windowClass);
+        info.hasClass = windowClass.bytes() != nullptr;
+        // WM_CLASS is two null terminated strings. res_name followed by res_class.
+        QList<QByteArray> parts = windowClass.toByteArray().split('\0');
+        info.resNameUtf8 = parts.value(0);
+        info.resClassUtf8 = parts.value(1);
+        info.resName = QString::fromUtf8(info.resNameUtf8);
+        info.resClass = QString::fromUtf8(info.resClassUtf8);
+
+        XcbPropertyReply name = batch.take(request.name);
+        info.hasName = name.bytes() != nullptr;
+        info.nameUtf8 = name.toByteArray();
+        info.name = QString::fromUtf8(info.nameUtf8);
+
+        // Prefer _NET_WM_NAME because it's always UTF-8.
+        if (fields & XLibUtilWindowInfo::Title) {
+            info.titleUtf8 = batch.take(request.netName).toByteArray();
+            if (info.titleUtf8.isEmpty())
+                info.titleUtf8 = info.nameUtf8;
+            info.title = QString::fromUtf8(info.titleUtf8);
+        }
+
+        info.roleUtf8 = batch.take(request.role).toByteArray();
+        info.role = QString::fromUtf8(info.roleUtf8);
+
+        uint32_t desktop = 0;
+        batch.take(request.desktop).value32(&desktop);
+        info.desktop = toDesktop(desktop);
+
+        info.startupId = batch.take(request.startupId).toByteArray();
+
+        if (fields & XLibUtilWindowInfo::State) {
+            XcbPropertyReply wmState = batch.take(request.normality.wmState);
+            XcbPropertyReply windowState = batch.take(request.normality.windowState);
+            XcbPropertyReply transientFor = batch.take(request.normality.transientFor);
+            XcbPropertyReply windowType = batch.take(request.normality.windowType);
+
+            uint32_t state = 0;
+            if (wmState.value32(&state))
+                info.wmState = static_cast<int>(state);
+            const uint32_t *types = windowType.values32();
+            for (uint32_t t = 0; types != nullptr && t < windowType.count(); t++) {
+                info.windowType.append(types[t]);
             }
+            info.normal = ::isNormalWindow(wmState, windowState, transientFor, windowType);
         }
-        XFree(data);
-        return (i == nitems);
-    } else {
-        return (transient_for == 0);
+
+        infos.append(info);
+    }
+
+    return infos;
+}
+
+// The properties needed to run the searches.
+static quint32 searchFields(const QList<XLibUtilWindowSearch> &searches)
+{
+    quint32 fields = 0;
+    for (const XLibUtilWindowSearch &search : searches) {
+        fields |= search.pid != 0 ? XLibUtilWindowInfo::Pid : search.expression.fields();
+        if (!search.startupId.isEmpty())
+            fields |= XLibUtilWindowInfo::StartupId;
+        if (search.checkNormality)
+            fields |= XLibUtilWindowInfo::State;
     }
+    return fields;
 }
 
-// Returns the contents of the _NET_WM_PID (which is supposed to contain the
-// process id of the application that created the window)
-static pid_t pid(Display *display, Window window)
+// Window managers following the EWMH spec list every window they manage
+// on the root window. Returns false if the window manager doesn't publish
+// the list.
+static bool getClientList(QList<windowid_t> *clients)
 {
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, leftover;
-    unsigned char *pid;
-    pid_t pid_return = -1;
-    static Atom type = XInternAtom(display, "_NET_WM_PID", false);
+    XcbPropertyBatch batch(getConnection());
+    XcbPropertyReply reply =
+        batch.take(batch.add(getDefaultRootWindow(), XLibUtil::atoms()._NET_CLIENT_LIST, XCB_ATOM_WINDOW));
 
-    if (XGetWindowProperty(display, window, type, 0, 1, false, XA_CARDINAL, &actual_type, &actual_format, &nitems,
-                           &leftover, &pid) == Success)
-    {
-        if (pid) {
-            pid_return = *(pid_t *)pid;
-        }
-        XFree(pid);
+    const uint32_t *windows = reply.values32();
+    if (windows == nullptr)
+        return false;
+
+    for (uint32_t i = 0; i < reply.count(); i++) {
+        clients->append(windows[i]);
     }
-    return pid_return;
+    return true;
 }
 
-// Walk the window's tree of subwindows until we find the window matching
-// the window with the pid we're looking for.
-static Window pidToWidEx(Display *display, Window window, bool checkNormality, pid_t epid)
+static QList<windowid_t> queryChildren(Display *display, Window window)
 {
-    Window w = 0;
+    QList<windowid_t> children;
     Window root;
     Window parent;
-    Window *child;
+    Window *child = NULL;
     unsigned int num_child;
 
     if (XQueryTree(display, window, &root, &parent, &child, &num_child) != 0) {
         for (unsigned int i = 0; i < num_child; i++) {
-            if (epid == pid(display, child[i])) {
-                if (checkNormality) {
-                    if (XLibUtil::isNormalWindow(child[i])) {
-                        return child[i];
-                    }
-                } else {
-                    return child[i];
-                }
-            }
-            w = pidToWidEx(display, child[i], checkNormality, epid);
-            if (w != 0) {
-                break;
-            }
+            children.append(child[i]);
         }
     }
 
-    return w;
+    if (child != NULL)
+        XFree(child);
+    return children;
 }
 
-windowid_t XLibUtil::pidToWid(bool checkNormality, pid_t epid)
+// Walk the window's tree of subwindows until we find the window matching
+// the window with the pid we're looking for. Only used when the window
+// manager doesn't publish _NET_CLIENT_LIST.
+static windowid_t pidToWidEx(Display *display, Window window, bool checkNormality, pid_t epid)
+{
+    QList<windowid_t> children = queryChildren(display, window);
+    QList<XLibUtilWindowInfo> infos =
+        XLibUtil::getWindowInfo(children, XLibUtilWindowInfo::Pid | XLibUtilWindowInfo::State);
+
+    for (int i = 0; i < children.size(); i++) {
+        if (epid == infos[i].pid && (!checkNormality || infos[i].normal)) {
+            return children[i];
+        }
+        windowid_t w = pidToWidEx(display, children[i], checkNormality, epid);
+        if (w != 0) {
+            return w;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef HAVE_XRES
+// X-Resource 1.2 is needed for XResQueryClientIds.
+static bool hasXRes(Display *display)
 {
-    // Walk from the top most (root) window going though all of them until we find
-    // the one we want. Hopefully find the one we want.
-    return pidToWidEx(getDisplay(), getDefaultRootWindow(), checkNormality, epid);
+    static int supported = -1;
+    if (supported == -1) {
+        int eventBase, errorBase;
+        int major = 0;
+        int minor = 0;
+        supported = XResQueryExtension(display, &eventBase, &errorBase) &&
+                    XResQueryVersion(display, &major, &minor) && (major > 1 || (major == 1 && minor >= 2));
+    }
+    return supported;
 }
+#endif
 
-// Checks if window window has matching name
-static bool analyzeWindow(Display *display, windowid_t window, const QRegularExpression &ename)
+// The first of windows created by one of pid's connections to the X server.
+// The server knows which client created every window so this works for
+// windows without _NET_WM_PID. Only local clients have a pid.
+static windowid_t pidToWidXRes(Display *display, const QList<windowid_t> &windows, bool checkNormality, pid_t pid)
 {
-    // Can't analyze windows without a name
-    char *window_name = NULL;
-    if (!XFetchName(display, window, &window_name))
-        return false;
+#ifdef HAVE_XRES
+    if (windows.isEmpty() || !hasXRes(display))
+        return 0;
 
-    if (window_name) {
-        XFree(window_name);
-    } else {
-        return false;
+    // The resource base of each of pid's clients.
+    XResClientIdSpec spec;
+    spec.client = None;
+    spec.mask = XRES_CLIENT_ID_PID_MASK;
+    long count = 0;
+    XResClientIdValue *ids = nullptr;
+    if (XResQueryClientIds(display, 1, &spec, &count, &ids) != Success)
+        return 0;
+    QList<XID> bases;
+    for (long i = 0; i < count; i++) {
+        if (XResGetClientPid(&ids[i]) == pid)
+            bases.append(ids[i].spec.client);
     }
+    XResClientIdsDestroy(count, ids);
+    if (bases.isEmpty())
+        return 0;
 
-    // lets try the program name
-    bool this_is_our_man = false;
-    XClassHint ch;
-    memset(&ch, 0, sizeof(ch));
-    if (XGetClassHint(display, window, &ch)) {
-        // Checking res_name first because it is the window title and for
-        // something like a text editor could show the document name or
-        // something like "unsaved". This allows for the user to more
-        // robustly match if there are multiple windows they're trying
-        // to differentiate multiple windows of the same application.
-        //
-        // Fall back to res_class which is the application name.
-        if (ch.res_name && QString(ch.res_name).contains(ename)) {
-            this_is_our_man = true;
-        } else if (ch.res_class && QString(ch.res_class).contains(ename)) {
-            this_is_our_man = true;
-        } else {
-            // sheer desperation
-            char *wm_name = NULL;
-            XFetchName(display, window, &wm_name);
-            if (wm_name && QString(wm_name).contains(ename)) {
-                this_is_our_man = true;
-            }
-            XFree(wm_name);
+    // Every id a client creates is its base with bits inside its mask set.
+    int clientCount = 0;
+    XResClient *clients = nullptr;
+    if (!XResQueryClients(display, &clientCount, &clients))
+        return 0;
+    QList<windowid_t> owned;
+    for (int i = 0; i < clientCount; i++) {
+        if (!bases.contains(clients[i].resource_base))
+            continue;
+        for (windowid_t window : windows) {
+            if ((window & ~clients[i].resource_mask) == clients[i].resource_base)
+                owned.append(window);
         }
+    }
+    XFree(clients);
 
-        if (ch.res_class) {
-            XFree(ch.res_class);
-        }
-        if (ch.res_name) {
-            XFree(ch.res_name);
-        }
+    for (const XLibUtilWindowInfo &info : XLibUtil::getWindowInfo(owned, XLibUtilWindowInfo::State)) {
+        if (!checkNormality || info.normal)
+            return info.window;
+    }
+#else
+    Q_UNUSED(display);
+    Q_UNUSED(windows);
+    Q_UNUSED(checkNormality);
+    Q_UNUSED(pid);
+#endif
+    return 0;
+}
+
+windowid_t XLibUtil::pidToWid(bool checkNormality, pid_t epid)
+{
+    QList<windowid_t> clients;
+    if (!getClientList(&clients)) {
+        // Without a window manager the top level windows are the application windows.
+        windowid_t window = pidToWidXRes(getDisplay(), getTopLevelWindows(), checkNormality, epid);
+        if (window != 0)
+            return window;
+        // Walk from the top most (root) window going though all of them until we find
+        // the one we want. Hopefully find the one we want.
+        return pidToWidEx(getDisplay(), getDefaultRootWindow(), checkNormality, epid);
     }
 
-    return this_is_our_man;
+    for (const XLibUtilWindowInfo &info :
+         getWindowInfo(clients, XLibUtilWindowInfo::Pid | XLibUtilWindowInfo::State)) {
+        if (info.pid == epid && (!checkNormality || info.normal)) {
+            return info.window;
+        }
+    }
+    // The windows don't have _NET_WM_PID set.
+    return pidToWidXRes(getDisplay(), clients, checkNormality, epid);
 }
 
-// Given a starting window look though all children and try to find a window
-// that matches the ename.
-static Window findWindowEx(Display *display, Window window, bool checkNormality, const QRegularExpression &ename,
-                           QList<windowid_t> dockedWindows = QList<windowid_t>())
+void XLibUtil::matchWindows(const QList<XLibUtilWindowSearch> &searches, const QList<XLibUtilWindowInfo> &windows,
+                            const QList<windowid_t> &dockedWindows, QList<windowid_t> *found)
 {
-    Window w = 0;
-    Window root;
-    Window parent;
-    Window *child;
-    unsigned int num_child;
-    if (XQueryTree(display, window, &root, &parent, &child, &num_child) != 0) {
-        for (unsigned int i = 0; i < num_child; i++) {
-            if (analyzeWindow(display, child[i], ename)) {
-                if (!dockedWindows.contains(child[i])) {
-                    if (checkNormality) {
-                        if (XLibUtil::isNormalWindow(child[i])) {
-                            return child[i];
-                        }
-                    } else {
-                        return child[i];
-                    }
-                }
+    for (const XLibUtilWindowInfo &info : windows) {
+        // Several searches can match the same window but only one can dock
+        // it. Earlier searches take it first.
+        if (dockedWindows.contains(info.window) || found->contains(info.window))
+            continue;
+
+        for (int i = 0; i < searches.size(); i++) {
+            const XLibUtilWindowSearch &search = searches[i];
+            if ((*found)[i] != 0)
+                continue;
+            if (search.checkNormality && !info.normal)
+                continue;
+
+            bool matched = false;
+            if (!search.startupId.isEmpty() && info.startupId == search.startupId) {
+                // Exact. The window was opened for this launch.
+                matched = true;
+            } else if (search.pid != 0) {
+                matched = info.pid == search.pid || search.descendants.contains(info.pid);
+            } else {
+                matched = search.expression.matches(info);
             }
-            w = findWindowEx(display, child[i], checkNormality, ename, dockedWindows);
-            if (w != 0) {
+            if (matched) {
+                (*found)[i] = info.window;
                 break;
             }
         }
     }
-    return w;
 }
 
-windowid_t XLibUtil::findWindow(bool checkNormality, const QRegularExpression &ename, QList<windowid_t> dockedWindows)
+// Only used when the window manager doesn't publish _NET_CLIENT_LIST. Walks the
+// tree a level at a time testing each level against every search.
+static QList<windowid_t> findWindowsEx(Display *display, Window window, const QList<XLibUtilWindowSearch> &searches,
+                                       const QList<windowid_t> &dockedWindows)
+{
+    quint32 fields = searchFields(searches);
+    QList<windowid_t> found(searches.size(), 0);
+    QList<windowid_t> level = queryChildren(display, window);
+    while (!level.isEmpty() && found.contains(0)) {
+        XLibUtil::matchWindows(searches, XLibUtil::getWindowInfo(level, fields), dockedWindows, &found);
+
+        QList<windowid_t> next;
+        for (windowid_t child : std::as_const(level)) {
+            next.append(queryChildren(display, child));
+        }
+        level = next;
+    }
+    return found;
+}
+
+QList<windowid_t> XLibUtil::findWindows(const QList<XLibUtilWindowSearch> &searches,
+                                        const QList<windowid_t> &dockedWindows)
+{
+    QList<windowid_t> clients;
+    if (!getClientList(&clients))
+        return findWindowsEx(getDisplay(), getDefaultRootWindow(), searches, dockedWindows);
+
+    return findWindows(searches, clients, dockedWindows);
+}
+
+QList<windowid_t> XLibUtil::findWindows(const QList<XLibUtilWindowSearch> &searches,
+                                        const QList<windowid_t> &candidates, const QList<windowid_t> &dockedWindows)
+{
+    QList<windowid_t> found(searches.size(), 0);
+    matchWindows(searches, getWindowInfo(candidates, searchFields(searches)), dockedWindows, &found);
+    return found;
+}
+
+bool XLibUtil::getClientWindows(QList<windowid_t> *clients)
+{
+    return getClientList(clients);
+}
+
+windowid_t XLibUtil::getRootWindow()
+{
+    return getDefaultRootWindow();
+}
+
+QList<windowid_t> XLibUtil::getTopLevelWindows()
+{
+    return queryChildren(getDisplay(), getDefaultRootWindow());
+}
+
+// State of the XLibUtilBatch objects that are alive.
+static int batchDepth = 0;
+// A request in the batch needs the server to have processed it before
+// the batch ends.
+static bool batchNeedsSync = false;
+
+XLibUtilBatch::XLibUtilBatch()
+{
+    batchDepth++;
+}
+
+XLibUtilBatch::~XLibUtilBatch()
+{
+    if (--batchDepth > 0)
+        return;
+
+    Display *display = getDisplay();
+    if (batchNeedsSync) {
+        XSync(display, false);
+    } else {
+        XFlush(display);
+    }
+    batchNeedsSync = false;
+}
+
+// Waits for the server to process every request sent so far. Within a batch
+// this happens once when the batch ends.
+static void syncRequests(Display *display)
 {
-    // Walk from the top most (root) window going though all of them until we find
-    // the one we want. Hopefully find the one we want.
-    return findWindowEx(getDisplay(), getDefaultRootWindow(), checkNormality, ename, dockedWindows);
+    if (batchDepth > 0) {
+        batchNeedsSync = true;
+    } else {
+        XSync(display, false);
+    }
+}
+
+static void flushRequests(Display *display)
+{
+    if (batchDepth == 0)
+        XFlush(display);
 }
 
 // Sends a given ClientMessage to a window.
@@ -334,172 +848,203 @@ static void sendMessage(Display *display, Window to, Window window, Atom type, i
     ev.xclient.format = format;
     memcpy((char *)&ev.xclient.data, (const char *)data, size);
     XSendEvent(display, to, false, mask, &ev);
-    XSync(display, false);
+    syncRequests(display);
 }
 
 void sendMessageWMState(Window window, Atom state_type, bool set)
 {
-    Display *display = getDisplay();
-    static Atom type = XInternAtom(display, "_NET_WM_STATE", true);
     // true = add the state to the window.
     // false, remove the state from the window.
     qint64 l[2] = {set ? 1 : 0, static_cast<qint64>(state_type)};
-    sendMessage(display, getDefaultRootWindow(), window, type, 32, SubstructureNotifyMask, l, sizeof(l));
+    sendMessage(getDisplay(), getDefaultRootWindow(), window, XLibUtil::atoms()._NET_WM_STATE, 32,
+                SubstructureNotifyMask, l, sizeof(l));
 }
 
 void XLibUtil::setWindowSkipTaskbar(windowid_t window, bool set)
 {
-    static Atom atom = XInternAtom(getDisplay(), "_NET_WM_STATE_SKIP_TASKBAR", false);
-    sendMessageWMState(window, atom, set);
+    sendMessageWMState(window, atoms()._NET_WM_STATE_SKIP_TASKBAR, set);
 }
 
 void XLibUtil::setWindowSkipPager(windowid_t window, bool set)
 {
-    static Atom atom = XInternAtom(getDisplay(), "_NET_WM_STATE_SKIP_PAGER", false);
-    sendMessageWMState(window, atom, set);
+    sendMessageWMState(window, atoms()._NET_WM_STATE_SKIP_PAGER, set);
 }
 
 void XLibUtil::setWindowSticky(windowid_t window, bool set)
 {
-    static Atom atom = XInternAtom(getDisplay(), "_NET_WM_STATE_STICKY", false);
-    sendMessageWMState(window, atom, set);
+    sendMessageWMState(window, atoms()._NET_WM_STATE_STICKY, set);
 }
 
 void XLibUtil::setCurrentDesktop(long desktop)
 {
-    Display *display = getDisplay();
-    static Atom type = XInternAtom(display, "_NET_CURRENT_DESKTOP", true);
     Window root = getDefaultRootWindow();
     long l_currDesk[2] = {desktop, CurrentTime};
-    sendMessage(display, root, root, type, 32, SubstructureNotifyMask | SubstructureRedirectMask, l_currDesk,
-                sizeof(l_currDesk));
+    sendMessage(getDisplay(), root, root, atoms()._NET_CURRENT_DESKTOP, 32,
+                SubstructureNotifyMask | SubstructureRedirectMask, l_currDesk, sizeof(l_currDesk));
 }
 
 void XLibUtil::setWindowDesktop(long desktop, windowid_t window)
 {
-    Display *display = getDisplay();
-    static Atom type = XInternAtom(display, "_NET_WM_DESKTOP", true);
     long l_wmDesk[2] = {desktop, 1}; // 1 == request sent from application. 2 == from pager
-    sendMessage(display, getDefaultRootWindow(), window, type, 32, SubstructureNotifyMask | SubstructureRedirectMask,
-                l_wmDesk, sizeof(l_wmDesk));
+    sendMessage(getDisplay(), getDefaultRootWindow(), window, atoms()._NET_WM_DESKTOP, 32,
+                SubstructureNotifyMask | SubstructureRedirectMask, l_wmDesk, sizeof(l_wmDesk));
 }
 
 void XLibUtil::setActiveWindow(windowid_t window)
 {
     Display *display = getDisplay();
-    static Atom type = XInternAtom(display, "_NET_ACTIVE_WINDOW", true);
     // 1 == request sent from application. 2 == from pager.
     // We use 2 because KWin doesn't always give the window focus with 1.
     long l_active[2] = {2, CurrentTime};
-    sendMessage(getDisplay(), getDefaultRootWindow(), window, type, 32,
+    sendMessage(display, getDefaultRootWindow(), window, atoms()._NET_ACTIVE_WINDOW, 32,
                 SubstructureNotifyMask | SubstructureRedirectMask, l_active, sizeof(l_active));
     XSetInputFocus(display, window, RevertToParent, CurrentTime);
 }
 
 void XLibUtil::closeWindow(windowid_t window)
 {
-    static Atom type = XInternAtom(getDisplay(), "_NET_CLOSE_WINDOW", true);
     long l[5] = {0, 0, 0, 0, 0};
-    sendMessage(getDisplay(), getDefaultRootWindow(), window, type, 32,
+    sendMessage(getDisplay(), getDefaultRootWindow(), window, atoms()._NET_CLOSE_WINDOW, 32,
                 SubstructureNotifyMask | SubstructureRedirectMask, l, sizeof(l));
 }
 
 // Returns the id of the currently active window.
 windowid_t XLibUtil::getActiveWindow()
 {
-    Display *display = getDisplay();
-    Atom active_window_atom = XInternAtom(getDisplay(), "_NET_ACTIVE_WINDOW", true);
-    Atom type = 0;
-    int format;
-    unsigned long nitems, after;
-    unsigned char *data = NULL;
-    Window root = getDefaultRootWindow();
+    XcbPropertyBatch batch(getConnection());
+    XcbPropertyReply reply =
+        batch.take(batch.add(getDefaultRootWindow(), atoms()._NET_ACTIVE_WINDOW, XCB_ATOM_ANY, 1));
+
+    uint32_t active = 0;
+    if (reply.value32(&active) && active != 0)
+        return active;
 
-    int r = XGetWindowProperty(display, root, active_window_atom, 0, 1, false, AnyPropertyType, &type, &format, &nitems,
-                               &after, &data);
+    return getInputFocus();
+}
 
+windowid_t XLibUtil::getInputFocus()
+{
     Window window = 0;
-    if ((r == Success) && data && (*reinterpret_cast<windowid_t *>(data) != 0)) {
-        window = *(windowid_t *)data;
-    } else {
-        int revert;
-        XGetInputFocus(display, &window, &revert);
-    }
+    int revert;
+    XGetInputFocus(getDisplay(), &window, &revert);
     return window;
 }
 
 static windowid_t findWMStateWindowChildren(Display *display, windowid_t window, Atom wmState)
 {
-    Window w = 0;
     Window root;
     Window parent;
     Window *child;
     unsigned int num_child;
 
-    if (XQueryTree(display, window, &root, &parent, &child, &num_child) != 0) {
-        for (unsigned int i = 0; i < num_child; i++) {
-            int format;
-            unsigned long left;
-            Atom *data = NULL;
-            Atom type = 0;
-            unsigned long nitems;
-
-            int ret = XGetWindowProperty(display, child[i], wmState, 0, 0, false, AnyPropertyType, &type, &format,
-                                         &nitems, &left, (unsigned char **)&data);
-
-            if (data != NULL) {
-                XFree(data);
-            }
+    if (XQueryTree(display, window, &root, &parent, &child, &num_child) == 0)
+        return 0;
 
-            if (ret == Success && type) {
-                return child[i];
-            }
+    // The WM_STATE of every child is requested at once so the level costs a
+    // single round trip. The children are still searched depth first, each
+    // child's subtree before the next child, to keep the order KDocker has
+    // always used. XmuClientWindow checks every child before recursing into
+    // any. The level's later children are read even when an earlier
+    // child's subtree has the match.
+    XcbPropertyBatch batch(getConnection());
+    QList<int> ids;
+    for (unsigned int i = 0; i < num_child; i++) {
+        ids.append(batch.add(child[i], wmState, XCB_ATOM_ANY, 0));
+    }
+    QList<bool> hasState;
+    for (unsigned int i = 0; i < num_child; i++) {
+        hasState.append(batch.take(ids[i]).exists());
+    }
 
+    windowid_t w = 0;
+    for (unsigned int i = 0; i < num_child && w == 0; i++) {
+        if (hasState[i]) {
+            w = child[i];
+        } else {
             w = findWMStateWindowChildren(display, child[i], wmState);
-            if (w != 0) {
-                return w;
-            }
         }
     }
 
+    if (child != NULL)
+        XFree(child);
     return w;
 }
 
-// Functional equivelent to libXmu's XmuClientWindow.
+// Like libXmu's XmuClientWindow but searching depth first. See
+// findWMStateWindowChildren.
 static windowid_t findWMStateWindow(Display *display, windowid_t window)
 {
-    int format;
-    unsigned long left;
-    Atom *data = NULL;
-    Atom type = 0;
-    unsigned long nitems;
-    static Atom wmState = XInternAtom(display, "WM_STATE", false);
+    atom_t wmState = XLibUtil::atoms().WM_STATE;
 
-    int ret = XGetWindowProperty(display, window, wmState, 0, 0, false, AnyPropertyType, &type, &format, &nitems, &left,
-                                 (unsigned char **)&data);
-    if (data != NULL)
-        XFree(data);
-
-    if (ret == Success && type)
+    XcbPropertyBatch batch(getConnection());
+    if (batch.take(batch.add(window, wmState, XCB_ATOM_ANY, 0)).exists())
         return window;
 
     return findWMStateWindowChildren(display, window, wmState);
 }
 
-windowid_t XLibUtil::selectWindow(GrabInfo &grabInfo, QString &error)
+// Adds events to the ones we're already receiving from each window. The
+// attributes of every window are requested together. Returns the events
+// that were added so they can be removed later without disturbing events
+// selected by anything else (such as Qt).
+static QHash<windowid_t, quint32> addEventMask(const QList<windowid_t> &windows, uint32_t mask)
+{
+    xcb_connection_t *connection = getConnection();
+    QList<xcb_get_window_attributes_cookie_t> cookies;
+    for (windowid_t window : windows) {
+        cookies.append(xcb_get_window_attributes(connection, window));
+    }
+
+    QHash<windowid_t, quint32> added;
+    for (int i = 0; i < windows.size(); i++) {
+        xcb_get_window_attributes_reply_t *reply = xcb_get_window_attributes_reply(connection, cookies[i], nullptr);
+        // The window is gone.
+        if (reply == nullptr)
+            continue;
+
+        uint32_t current = reply->your_event_mask;
+        free(reply);
+
+        uint32_t missing = mask & ~current;
+        if (missing == 0)
+            continue;
+
+        // The window could be destroyed at any point. Discarding the checked
+        // cookie drops the error instead of having it reported.
+        uint32_t value = current | missing;
+        xcb_void_cookie_t cookie =
+            xcb_change_window_attributes_checked(connection, windows[i], XCB_CW_EVENT_MASK, &value);
+        xcb_discard_reply(connection, cookie.sequence);
+        added.insert(windows[i], missing);
+    }
+
+    xcb_flush(connection);
+    return added;
+}
+
+windowid_t XLibUtil::getClientWindow(windowid_t window)
+{
+    windowid_t client = findWMStateWindow(getDisplay(), window);
+    if (client != 0)
+        return client;
+    return window;
+}
+
+bool XLibUtil::grabSelection(XLibUtilGrab &grab, QString &error)
 {
     Display *display = getDisplay();
     Window root = getDefaultRootWindow();
     Cursor cursor = XCreateFontCursor(display, XC_draped_box);
     if (cursor == 0) {
         error = tr("Failed to create XC_draped_box");
-        return 0;
+        return false;
     }
     if (XGrabPointer(display, root, false, ButtonPressMask | ButtonReleaseMask, GrabModeSync, GrabModeAsync, 0, cursor,
                      CurrentTime) != GrabSuccess)
     {
+        XFreeCursor(display, cursor);
         error = tr("Failed to grab mouse");
-        return 0;
+        return false;
     }
 
     //  X11 treats Scroll_Lock & Num_Lock as 'modifiers'; each exact combination has to be grabbed
@@ -512,140 +1057,152 @@ windowid_t XLibUtil::selectWindow(GrabInfo &grabInfo, QString &error)
                         ((b & BIT2) ? Mod5Mask : 0);  // SCROLL_lock
         XGrabKey(display, keyEsc, modifiers, root, False, GrabModeAsync, GrabModeAsync);
     }
-    XSelectInput(display, root, KeyPressMask);
+    grab.addedMask = addEventMask({static_cast<windowid_t>(root)}, KeyPressMask);
     XAllowEvents(display, SyncPointer, CurrentTime);
-    XSync(display, false);
-
-    grabInfo.exec(); // Block waiting for a selection, cancel, or timeout.
-
-    XUngrabPointer(display, CurrentTime);
-    XUngrabKey(display, keyEsc, AnyModifier, root);
-    XSelectInput(display, root, NoEventMask);
-    XFreeCursor(display, cursor);
-
-    if (grabInfo.getButton() != Button1 || !grabInfo.getWindow() || !grabInfo.isActive())
-        return 0;
+    // Flushed rather than synced. Nothing is waited on until the user
+    // makes a selection.
+    XFlush(display);
 
-    // Find window (or subwindow) of the grabbed window with WM_STATE which should be a dockable window.
-    windowid_t w = findWMStateWindow(display, grabInfo.getWindow());
-    if (w != 0)
-        return w;
-    // Return the window that was grabbed even if it's not a proper dockable window.
-    // It was grabbed and if the user want's to check if it's a valid window they have
-    // that option which happens elsewhere.
-    return grabInfo.getWindow();
+    grab.active = true;
+    grab.cursor = cursor;
+    grab.escapeKey = keyEsc;
+    return true;
 }
 
-void XLibUtil::subscribe(windowid_t window)
+void XLibUtil::ungrabSelection(XLibUtilGrab &grab)
 {
+    if (!grab.active)
+        return;
+
     Display *display = getDisplay();
-    Window root = getDefaultRootWindow();
-    XWindowAttributes attr;
+    XUngrabPointer(display, CurrentTime);
+    XUngrabKey(display, grab.escapeKey, AnyModifier, getDefaultRootWindow());
+    unSubscribe(grab.addedMask);
+    XFreeCursor(display, grab.cursor);
+    XFlush(display);
+    grab = XLibUtilGrab();
+}
 
-    XGetWindowAttributes(display, window == 0 ? root : window, &attr);
+QHash<windowid_t, quint32> XLibUtil::subscribe(windowid_t window)
+{
+    return addEventMask({window == 0 ? getDefaultRootWindow() : window},
+                        XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE |
+                            XCB_EVENT_MASK_VISIBILITY_CHANGE | XCB_EVENT_MASK_FOCUS_CHANGE);
+}
 
-    XSelectInput(display, window == 0 ? root : window,
-                 attr.your_event_mask | StructureNotifyMask | PropertyChangeMask | VisibilityChangeMask |
-                     FocusChangeMask);
-    XSync(display, false);
+QHash<windowid_t, quint32> XLibUtil::subscribeNewWindows()
+{
+    return addEventMask({getDefaultRootWindow()}, XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE);
 }
 
-void XLibUtil::unSubscribe(windowid_t window)
+QHash<windowid_t, quint32> XLibUtil::subscribeProperties(const QList<windowid_t> &windows)
 {
-    Display *display = getDisplay();
-    XSelectInput(display, window, NoEventMask);
-    XSync(display, false);
+    return addEventMask(windows, XCB_EVENT_MASK_PROPERTY_CHANGE);
 }
 
-// Sets data to the value of the requested window property.
-bool getCardinalProperty(Display *display, windowid_t window, Atom prop, long *data)
+void XLibUtil::unSubscribe(const QHash<windowid_t, quint32> &added)
 {
-    Atom type;
-    int format;
-    unsigned long nitems, bytes;
-    unsigned char *d = NULL;
+    xcb_connection_t *connection = getConnection();
+    QList<windowid_t> windows = added.keys();
+    QList<xcb_get_window_attributes_cookie_t> cookies;
+    for (windowid_t window : windows) {
+        cookies.append(xcb_get_window_attributes(connection, window));
+    }
 
-    if (XGetWindowProperty(display, window, prop, 0, 1, false, XA_CARDINAL, &type, &format, &nitems, &bytes, &d) ==
-            Success &&
-        d)
-    {
-        if (data) {
-            *data = *reinterpret_cast<long *>(d);
-        }
-        XFree(d);
-        return true;
+    for (int i = 0; i < windows.size(); i++) {
+        xcb_get_window_attributes_reply_t *reply = xcb_get_window_attributes_reply(connection, cookies[i], nullptr);
+        if (reply == nullptr)
+            continue;
+
+        uint32_t value = reply->your_event_mask & ~added.value(windows[i]);
+        free(reply);
+
+        xcb_void_cookie_t cookie =
+            xcb_change_window_attributes_checked(connection, windows[i], XCB_CW_EVENT_MASK, &value);
+        xcb_discard_reply(connection, cookie.sequence);
     }
-    return false;
-}
 
-long XLibUtil::getWindowDesktop(windowid_t window)
-{
-    long desktop = 0;
-    Display *display = getDisplay();
-    static Atom _NET_WM_DESKTOP = XInternAtom(display, "_NET_WM_DESKTOP", true);
-    getCardinalProperty(display, window, _NET_WM_DESKTOP, &desktop);
-    return desktop;
+    xcb_flush(connection);
 }
 
-long XLibUtil::getCurrentDesktop()
+long XLibUtil::getWindowDesktop(windowid_t window, XLibUtilError *error)
 {
-    long desktop = 0;
-    Display *display = getDisplay();
-    Atom type = 0;
-    int format;
-    unsigned long nitems, after;
-    unsigned char *data = 0;
+    XcbPropertyBatch batch(getConnection());
+    XcbPropertyReply reply = batch.take(batch.add(window, atoms()._NET_WM_DESKTOP, XCB_ATOM_CARDINAL, 1), error);
 
-    static Atom _NET_CURRENT_DESKTOP = XInternAtom(display, "_NET_CURRENT_DESKTOP", true);
+    uint32_t desktop = 0;
+    reply.value32(&desktop);
+    return toDesktop(desktop);
+}
 
-    int r = XGetWindowProperty(display, DefaultRootWindow(display), _NET_CURRENT_DESKTOP, 0, 4, false, AnyPropertyType,
-                               &type, &format, &nitems, &after, &data);
-    if (r == Success && data)
-        desktop = *reinterpret_cast<long *>(data);
+XLibUtilRootState XLibUtil::getRootState()
+{
+    const XLibUtilAtoms &atoms = XLibUtil::atoms();
+    windowid_t root = getDefaultRootWindow();
+
+    XcbPropertyBatch batch(getConnection());
+    int currentDesktopId = batch.add(root, atoms._NET_CURRENT_DESKTOP, XCB_ATOM_CARDINAL, 1);
+    int desktopCountId = batch.add(root, atoms._NET_NUMBER_OF_DESKTOPS, XCB_ATOM_CARDINAL, 1);
+    int activeWindowId = batch.add(root, atoms._NET_ACTIVE_WINDOW, XCB_ATOM_WINDOW, 1);
+    int stackingId = batch.add(root, atoms._NET_CLIENT_LIST_STACKING, XCB_ATOM_WINDOW);
+
+    XLibUtilRootState state;
+    uint32_t value = 0;
+    if (batch.take(currentDesktopId).value32(&value))
+        state.currentDesktop = toDesktop(value);
+    if (batch.take(desktopCountId).value32(&value))
+        state.desktopCount = value;
+
+    XcbPropertyReply activeWindow = batch.take(activeWindowId);
+    state.hasActiveWindow = activeWindow.exists();
+    if (activeWindow.value32(&value))
+        state.activeWindow = value;
+
+    XcbPropertyReply stacking = batch.take(stackingId);
+    const uint32_t *windows = stacking.values32();
+    for (uint32_t i = 0; windows != nullptr && i < stacking.count(); i++) {
+        state.stacking.append(windows[i]);
+    }
 
-    XFree(data);
-    return desktop;
+    return state;
 }
 
 void XLibUtil::iconifyWindow(windowid_t window)
 {
     Display *display = getDisplay();
-    int screen = DefaultScreen(display);
+    XIconifyWindow(display, window, DefaultScreen(display)); // good for effects too
+    flushRequests(display);
+}
 
-    // A simple call to XWithdrawWindow wont do. Here is what we do:
-    // 1. Iconify. This will make the application hide all its other windows. For
-    //    example, xmms would take off the playlist and equalizer window.
-    // 2. Withdraw the window to remove it from the taskbar.
-    XIconifyWindow(display, window, screen); // good for effects too
-    XSync(display, false);
-    XWithdrawWindow(display, window, screen);
+void XLibUtil::withdrawWindow(windowid_t window)
+{
+    Display *display = getDisplay();
+    XWithdrawWindow(display, window, DefaultScreen(display));
+    flushRequests(display);
 }
 
-// Is the window in an iconified state.
-bool XLibUtil::isWindowIconic(windowid_t window)
+void XLibUtil::unmapWindow(windowid_t window)
 {
-    bool iconic = false;
-    Atom type = 0;
-    int format;
-    unsigned long nitems, after;
-    unsigned char *data = 0;
     Display *display = getDisplay();
-    static Atom WM_STATE = XInternAtom(display, "WM_STATE", true);
+    XUnmapWindow(display, window);
+    flushRequests(display);
+}
 
-    int r = XGetWindowProperty(display, window, WM_STATE, 0, 1, false, AnyPropertyType, &type, &format, &nitems, &after,
-                               &data);
-    if ((r == Success) && data && (*reinterpret_cast<long *>(data) == IconicState))
-        iconic = true;
+// Is the window in an iconified state.
+bool XLibUtil::isWindowIconic(windowid_t window, XLibUtilError *error)
+{
+    XcbPropertyBatch batch(getConnection());
+    XcbPropertyReply reply = batch.take(batch.add(window, atoms().WM_STATE, XCB_ATOM_ANY, 1), error);
 
-    XFree(data);
-    return iconic;
+    uint32_t state = 0;
+    return reply.value32(&state) && state == IconicState;
 }
 
 void XLibUtil::raiseWindow(windowid_t window)
 {
     Display *display = getDisplay();
     XMapRaised(display, window);
-    XFlush(display);
+    flushRequests(display);
 }
 
 // We only consider images with at least 10% of pixels opaque. There have
@@ -659,7 +1216,7 @@ static bool imageMeetsMinimumOpaque(size_t num_opaque, size_t width, size_t heig
     return false;
 }
 
-static QRgb convertToQColor(unsigned long pixel)
+static QRgb convertToQColor(uint32_t pixel)
 {
     return qRgba((pixel & 0x00FF0000) >> 16,  // Red
                  (pixel & 0x0000FF00) >> 8,   // Green
@@ -667,21 +1224,21 @@ static QRgb convertToQColor(unsigned long pixel)
                  (pixel & 0xFF000000) >> 24); // Alpha
 }
 
-static QImage imageFromX11IconData(unsigned long *iconData, unsigned long dataLength)
+static QImage imageFromX11IconData(const uint32_t *iconData, uint32_t dataLength)
 {
     if (!iconData || dataLength < 2)
         return QImage();
 
-    unsigned long width = iconData[0];
-    unsigned long height = iconData[1];
+    uint32_t width = iconData[0];
+    uint32_t height = iconData[1];
 
-    if (width == 0 || height == 0 || dataLength < width * height + 2)
+    if (width == 0 || height == 0 || static_cast<quint64>(dataLength) < static_cast<quint64>(width) * height + 2)
         return QImage();
 
     size_t num_opaque = 0;
     QVector<QRgb> pixels(width * height);
-    unsigned long *src = iconData + 2;
-    for (unsigned long i = 0; i < width * height; ++i) {
+    const uint32_t *src = iconData + 2;
+    for (uint32_t i = 0; i < width * height; ++i) {
         pixels[i] = convertToQColor(src[i]);
         if (qAlpha(pixels[i]) != 0) {
             num_opaque++;
@@ -719,133 +1276,407 @@ static QImage imageFromX11Pixmap(Display *display, Pixmap pixmap, int x, int y,
     return result;
 }
 
-static QPixmap getWindowIconNetWMIcon(windowid_t window)
+static QImage getWindowIconNetWMIcon(const XcbPropertyReply &reply)
 {
-    QPixmap appIcon;
-    Display *display = getDisplay();
-    static Atom netWmIcon = XInternAtom(display, "_NET_WM_ICON", false);
-    Atom actualType;
-    int actualFormat;
-    unsigned long nItems, bytesAfter;
-    unsigned char *data = nullptr;
-
-    if (XGetWindowProperty(display, window, netWmIcon, 0, LONG_MAX, false, XA_CARDINAL, &actualType, &actualFormat,
-                &nItems, &bytesAfter, &data) != Success || data == NULL)
-        return appIcon;
-
-    if (actualFormat != 32)
-        return appIcon;
+    const uint32_t *iconData = reply.values32();
+    if (iconData == nullptr)
+        return QImage();
 
-    unsigned long *iconData = reinterpret_cast<unsigned long *>(data);
-    unsigned long dataLength = nItems;
+    uint32_t dataLength = reply.count();
 
     // Extract the largest icon available
     QImage largestImage;
-    unsigned long maxIconSize = 0;
+    quint64 maxIconSize = 0;
 
-    for (unsigned long i = 0; i < dataLength;) {
-        unsigned long width = iconData[i];
-        unsigned long height = iconData[i + 1];
-        unsigned long iconSize = width * height;
+    for (quint64 i = 0; i + 1 < dataLength;) {
+        quint64 iconSize = static_cast<quint64>(iconData[i]) * iconData[i + 1];
 
         if (iconSize > maxIconSize) {
-            largestImage = imageFromX11IconData(&iconData[i], dataLength - i);
+            largestImage = imageFromX11IconData(&iconData[i], static_cast<uint32_t>(dataLength - i));
             maxIconSize = iconSize;
         }
 
         i += (2 + iconSize);
     }
 
-    if (!largestImage.isNull())
-        appIcon = QPixmap::fromImage(largestImage);
-
-    XFree(data);
-    return appIcon;
+    return largestImage;
 }
 
-static QPixmap getWindowIconWMHints(windowid_t window)
+static QPixmap getWindowIconWMHints(const XcbPropertyReply &reply)
 {
     QPixmap appIcon;
     Display *display = getDisplay();
 
-    XWMHints *wm_hints = XGetWMHints(display, window);
-    if (wm_hints == nullptr)
+    // WM_HINTS is an XWMHints struct with each field being 32 bits.
+    // flags is the first field and icon_pixmap is the fourth.
+    const uint32_t *hints = reply.values32();
+    if (hints == nullptr || reply.count() < 4)
         return appIcon;
 
-    if (wm_hints->icon_pixmap) {
+    Pixmap iconPixmap = hints[3];
+    if ((hints[0] & IconPixmapHint) && iconPixmap) {
         Window root;
         int x = 0, y = 0;
         unsigned int width = 0, height = 0, border_width, depth;
-        XGetGeometry(display, wm_hints->icon_pixmap, &root, &x, &y, &width, &height, &border_width, &depth);
+        XGetGeometry(display, iconPixmap, &root, &x, &y, &width, &height, &border_width, &depth);
 
-        QImage image = imageFromX11Pixmap(display, wm_hints->icon_pixmap, x, y, width, height);
+        QImage image = imageFromX11Pixmap(display, iconPixmap, x, y, width, height);
         if (!image.isNull()) {
             appIcon = QPixmap::fromImage(image);
         }
     }
 
-    XFree(wm_hints);
     return appIcon;
 }
 
-QPixmap XLibUtil::getWindowIcon(windowid_t window)
+QPixmap XLibUtil::getWindowIcon(windowid_t window, XLibUtilError *error)
 {
     if (!window)
         return QPixmap();
 
+    // Both locations are requested together so falling back doesn't
+    // cost another round trip.
+    XcbPropertyBatch batch(getConnection());
+    int netWmIconId = batch.add(window, atoms()._NET_WM_ICON, XCB_ATOM_CARDINAL);
+    int wmHintsId = batch.add(window, XCB_ATOM_WM_HINTS, XCB_ATOM_WM_HINTS, 9);
+
     // First try _NET_WM_ICON
-    QPixmap appIcon = getWindowIconNetWMIcon(window);
+    QPixmap appIcon;
+    QImage image = getWindowIconNetWMIcon(batch.take(netWmIconId, error));
+    if (error != nullptr && *error != XLibUtilError::NoError)
+        return appIcon;
+    if (!image.isNull())
+        appIcon = QPixmap::fromImage(image);
 
     // Fallback to WM_HINTS if _NET_WM_ICON wasn't set
     if (appIcon.isNull())
-        appIcon = getWindowIconWMHints(window);
+        appIcon = getWindowIconWMHints(batch.take(wmHintsId));
 
     return appIcon;
 }
 
-QString XLibUtil::getAppName(windowid_t window)
+QImage XLibUtil::getWindowNetWMIcon(xcb_connection_t *connection, windowid_t window, XLibUtilError *error)
+{
+    if (!window)
+        return QImage();
+
+    XcbPropertyBatch batch(connection);
+    return getWindowIconNetWMIcon(batch.take(batch.add(window, atoms()._NET_WM_ICON, XCB_ATOM_CARDINAL), error));
+}
+
+QString XLibUtil::getAppName(windowid_t window, XLibUtilError *error)
+{
+    XcbPropertyBatch batch(getConnection());
+    XcbPropertyReply reply = batch.take(batch.add(window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING), error);
+
+    // WM_CLASS is two null terminated strings. res_name followed by res_class.
+    //
+    // res_class is the name of the application
+    //
+    // res_name is the text shown in the window title. Could include document
+    // names or something like "unsaved" like you'll see with a text editor
+    QList<QByteArray> parts = reply.toByteArray().split('\0');
+    if (!parts.value(1).isEmpty())
+        return QString::fromUtf8(parts.value(1));
+    return QString::fromUtf8(parts.value(0));
+}
+
+QString XLibUtil::getWindowTitle(windowid_t window, XLibUtilError *error)
+{
+    return getWindowTitle(getConnection(), window, error);
+}
+
+QString XLibUtil::getWindowTitle(xcb_connection_t *connection, windowid_t window, XLibUtilError *error)
+{
+    XcbPropertyBatch batch(connection);
+    int netWmNameId = batch.add(window, atoms()._NET_WM_NAME);
+    int wmNameId = batch.add(window, XCB_ATOM_WM_NAME);
+
+    // Prefer _NET_WM_NAME because it's always UTF-8. WM_NAME can
+    // be in a variety of encodings.
+    QByteArray title = batch.take(netWmNameId, error).toByteArray();
+    if (error != nullptr && *error != XLibUtilError::NoError)
+        return QString();
+    if (title.isEmpty())
+        title = batch.take(wmNameId, error).toByteArray();
+
+    return QString::fromUtf8(title);
+}
+
+// Coroutines read from their own connection. Its socket is watched by the
+// event loop and replies are picked up as they arrive. Nothing else reads
+// from the connection so nothing ever blocks waiting on the server.
+class XcbAsyncConnection
 {
-    XClassHint ch;
-    memset(&ch, 0, sizeof(ch));
-    QString name;
+public:
+    // nullptr if the connection couldn't be made. The coroutines then use
+    // the blocking functions.
+    static XcbAsyncConnection *instance()
+    {
+        static XcbAsyncConnection *async = create();
+        return async;
+    }
+
+    xcb_connection_t *connection() const
+    {
+        return m_connection;
+    }
+
+    // Returns true if the reply, or error, for the request has arrived.
+    bool poll(unsigned int sequence, void **reply, xcb_generic_error_t **error)
+    {
+        xcb_flush(m_connection);
+        return xcb_poll_for_reply(m_connection, sequence, reply, error) != 0 || xcb_connection_has_error(m_connection);
+    }
+
+    // Resumes the coroutine once the reply has arrived.
+    void wait(unsigned int sequence, std::coroutine_handle<> handle, void **reply, xcb_generic_error_t **error)
+    {
+        m_waiters.append({sequence, handle, reply, error});
+        // Sending can read what the server sent while the socket was full.
+        // That data won't wake the socket notifier.
+        if (!m_readQueued) {
+            m_readQueued = true;
+            QTimer::singleShot(0, &m_notifier, [this] { readReplies(); });
+        }
+    }
+
+private:
+    struct Waiter
+    {
+        unsigned int sequence;
+        std::coroutine_handle<> handle;
+        void **reply;
+        xcb_generic_error_t **error;
+    };
 
-    if (XGetClassHint(getDisplay(), window, &ch)) {
-        // res_class is the name of the application
-        //
-        // res_name is the text shown in the window title. Could include document
-        // names or something like "unsaved" like you'll see with a text editor
-        if (ch.res_class) {
-            name = QString(ch.res_class);
-        } else if (ch.res_name) {
-            name = QString(ch.res_name);
+    static XcbAsyncConnection *create()
+    {
+        xcb_connection_t *connection = xcb_connect(XLibUtil::getDisplayName().constData(), nullptr);
+        if (xcb_connection_has_error(connection)) {
+            xcb_disconnect(connection);
+            return nullptr;
         }
+        return new XcbAsyncConnection(connection);
+    }
+
+    explicit XcbAsyncConnection(xcb_connection_t *connection)
+        : m_connection(connection), m_notifier(xcb_get_file_descriptor(connection), QSocketNotifier::Read),
+          m_readQueued(false)
+    {
+        QObject::connect(&m_notifier, &QSocketNotifier::activated, &m_notifier, [this] { readReplies(); });
+    }
 
-        if (ch.res_class) {
-            XFree(ch.res_class);
+    void readReplies()
+    {
+        m_readQueued = false;
+
+        // Reads everything that has arrived. Nothing selects events on this
+        // connection and errors come back with the replies.
+        while (xcb_generic_event_t *event = xcb_poll_for_event(m_connection)) {
+            free(event);
+        }
+        // A lost connection resumes everything with no reply.
+        bool lost = xcb_connection_has_error(m_connection);
+        if (lost)
+            m_notifier.setEnabled(false);
+
+        QList<Waiter> ready;
+        for (qsizetype i = 0; i < m_waiters.size();) {
+            Waiter &waiter = m_waiters[i];
+            if (lost || xcb_poll_for_reply(m_connection, waiter.sequence, waiter.reply, waiter.error)) {
+                ready.append(waiter);
+                m_waiters.removeAt(i);
+            } else {
+                i++;
+            }
         }
-        if (ch.res_name) {
-            XFree(ch.res_name);
+
+        // Resumed coroutines can send more requests and wait again.
+        for (const Waiter &waiter : std::as_const(ready)) {
+            waiter.handle.resume();
         }
     }
 
-    return name;
+    xcb_connection_t *m_connection;
+    QSocketNotifier m_notifier;
+    bool m_readQueued;
+    QList<Waiter> m_waiters;
+};
+
+// co_await'ing suspends until the reply to the request arrives. The reply
+// is returned and owned by the caller. The request needs to have been sent
+// on XcbAsyncConnection and every request must be awaited.
+template <typename Reply> class XcbReplyAwaiter
+{
+public:
+    XcbReplyAwaiter(XcbAsyncConnection *async, unsigned int sequence, XLibUtilError *error = nullptr)
+        : m_async(async), m_sequence(sequence), m_error(error), m_reply(nullptr), m_xerror(nullptr)
+    {}
+
+    bool await_ready()
+    {
+        return m_async->poll(m_sequence, &m_reply, &m_xerror);
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_async->wait(m_sequence, handle, &m_reply, &m_xerror);
+    }
+
+    Reply *await_resume()
+    {
+        setError(m_xerror, m_error);
+        return static_cast<Reply *>(m_reply);
+    }
+
+private:
+    XcbAsyncConnection *m_async;
+    unsigned int m_sequence;
+    XLibUtilError *m_error;
+    void *m_reply;
+    xcb_generic_error_t *m_xerror;
+};
+
+static unsigned int requestProperty(XcbAsyncConnection *async, xcb_window_t window, xcb_atom_t property,
+                                    xcb_atom_t type = XCB_ATOM_ANY, uint32_t length = PROPERTY_LENGTH_ALL)
+{
+    return xcb_get_property(async->connection(), false, window, property, type, 0, length).sequence;
+}
+
+static XcbReplyAwaiter<xcb_get_property_reply_t> awaitProperty(XcbAsyncConnection *async, unsigned int sequence)
+{
+    return XcbReplyAwaiter<xcb_get_property_reply_t>(async, sequence);
 }
 
-QString XLibUtil::getWindowTitle(windowid_t window)
+// For each window, whether it belongs to pid and is a normal window when
+// checkNormality is set. Every request is sent before waiting on a reply.
+static Task<QList<bool>> matchPidAsync(XcbAsyncConnection *async, QList<windowid_t> windows, bool checkNormality,
+                                       pid_t pid)
 {
-    char *windowName = 0;
-    QString title;
+    const XLibUtilAtoms &atoms = XLibUtil::atoms();
+
+    QList<unsigned int> requests;
+    for (windowid_t window : std::as_const(windows)) {
+        requests.append(requestProperty(async, window, atoms._NET_WM_PID, XCB_ATOM_CARDINAL, 1));
+        requests.append(requestProperty(async, window, atoms.WM_STATE, XCB_ATOM_ANY, 10));
+        requests.append(requestProperty(async, window, atoms._NET_WM_STATE, XCB_ATOM_ANY, 10));
+        requests.append(requestProperty(async, window, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 1));
+        requests.append(requestProperty(async, window, atoms._NET_WM_WINDOW_TYPE, XCB_ATOM_ANY, 10));
+    }
 
-    XFetchName(getDisplay(), window, &windowName);
-    title = windowName;
+    QList<bool> matches;
+    for (qsizetype i = 0; i < requests.size(); i += 5) {
+        XcbPropertyReply pidReply(co_await awaitProperty(async, requests[i]));
+        XcbPropertyReply wmState(co_await awaitProperty(async, requests[i + 1]));
+        XcbPropertyReply windowState(co_await awaitProperty(async, requests[i + 2]));
+        XcbPropertyReply transientFor(co_await awaitProperty(async, requests[i + 3]));
+        XcbPropertyReply windowType(co_await awaitProperty(async, requests[i + 4]));
+
+        uint32_t value = 0;
+        bool match = pidReply.value32(&value) && static_cast<pid_t>(value) == pid;
+        if (match && checkNormality)
+            match = isNormalWindow(wmState, windowState, transientFor, windowType);
+        matches.append(match);
+    }
+    co_return matches;
+}
 
-    if (windowName)
-        XFree(windowName);
+// Same result as pidToWidEx. The tree is read a level at a time, one round
+// trip for the children of every window in the level and one for their
+// properties. The first match in pidToWidEx's depth first order is returned.
+static Task<windowid_t> pidToWidTreeAsync(XcbAsyncConnection *async, windowid_t root, bool checkNormality, pid_t pid)
+{
+    QHash<windowid_t, QList<windowid_t>> children;
+    QSet<windowid_t> matched;
+    QList<windowid_t> level = {root};
+    while (!level.isEmpty()) {
+        QList<unsigned int> requests;
+        for (windowid_t window : std::as_const(level)) {
+            requests.append(xcb_query_tree(async->connection(), window).sequence);
+        }
 
-    return title;
+        QList<windowid_t> next;
+        for (qsizetype i = 0; i < requests.size(); i++) {
+            xcb_query_tree_reply_t *tree = co_await XcbReplyAwaiter<xcb_query_tree_reply_t>(async, requests[i]);
+            if (tree == nullptr)
+                continue;
+            xcb_window_t *windows = xcb_query_tree_children(tree);
+            QList<windowid_t> &list = children[level[i]];
+            for (int j = 0; j < xcb_query_tree_children_length(tree); j++) {
+                list.append(windows[j]);
+            }
+            next.append(list);
+            free(tree);
+        }
+
+        QList<bool> matches = co_await matchPidAsync(async, next, checkNormality, pid);
+        for (qsizetype i = 0; i < next.size(); i++) {
+            if (matches[i])
+                matched.insert(next[i]);
+        }
+        level = next;
+    }
+    if (matched.isEmpty())
+        co_return 0;
+
+    // Pre-order, children in stacking order like pidToWidEx.
+    QList<windowid_t> stack = {root};
+    while (!stack.isEmpty()) {
+        windowid_t window = stack.takeLast();
+        if (window != root && matched.contains(window))
+            co_return window;
+        const QList<windowid_t> below = children.value(window);
+        for (auto it = below.crbegin(); it != below.crend(); ++it) {
+            stack.append(*it);
+        }
+    }
+    co_return 0;
 }
 
-atom_t XLibUtil::getAtom(const char *name)
+Task<windowid_t> XLibUtil::pidToWidAsync(bool checkNormality, pid_t pid)
 {
-    return XInternAtom(getDisplay(), name, true);
+    XcbAsyncConnection *async = XcbAsyncConnection::instance();
+    if (async == nullptr)
+        co_return pidToWid(checkNormality, pid);
+
+    XcbPropertyReply clientList(co_await awaitProperty(
+        async, requestProperty(async, getDefaultRootWindow(), atoms()._NET_CLIENT_LIST, XCB_ATOM_WINDOW)));
+    const uint32_t *clients = clientList.values32();
+    if (clients == nullptr) {
+        // Blocks, see pidToWidAsync. A few small requests. Cheap compared to
+        // the tree walk.
+        windowid_t window = pidToWidXRes(getDisplay(), getTopLevelWindows(), checkNormality, pid);
+        if (window != 0)
+            co_return window;
+        co_return co_await pidToWidTreeAsync(async, getDefaultRootWindow(), checkNormality, pid);
+    }
+
+    QList<windowid_t> windows(clients, clients + clientList.count());
+    QList<bool> matches = co_await matchPidAsync(async, windows, checkNormality, pid);
+    qsizetype index = matches.indexOf(true);
+    if (index != -1)
+        co_return windows[index];
+    // Blocks, see pidToWidAsync.
+    co_return pidToWidXRes(getDisplay(), windows, checkNormality, pid);
+}
+
+Task<QPixmap> XLibUtil::getWindowIconAsync(windowid_t window)
+{
+    XcbAsyncConnection *async = XcbAsyncConnection::instance();
+    if (async == nullptr)
+        co_return getWindowIcon(window);
+    if (!window)
+        co_return QPixmap();
+
+    unsigned int netWmIcon = requestProperty(async, window, atoms()._NET_WM_ICON, XCB_ATOM_CARDINAL);
+    unsigned int wmHints = requestProperty(async, window, XCB_ATOM_WM_HINTS, XCB_ATOM_WM_HINTS, 9);
+    XcbPropertyReply netWmIconReply(co_await awaitProperty(async, netWmIcon));
+    XcbPropertyReply wmHintsReply(co_await awaitProperty(async, wmHints));
+
+    QImage image = getWindowIconNetWMIcon(netWmIconReply);
+    if (!image.isNull())
+        co_return QPixmap::fromImage(image);
+    // The icon pixmap itself is still read with Xlib.
+    co_return getWindowIconWMHints(wmHintsReply);
 }
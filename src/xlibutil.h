@@ -21,13 +21,17 @@
 #ifndef _XLIBUTIL_H
 #define _XLIBUTIL_H
 
-#include "grabinfo.h"
+#include "matchexpression.h"
+#include "task.h"
 #include "xlibtypes.h"
 
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
 #include <QList>
 #include <QObject>
 #include <QPixmap>
-#include <QRegularExpression>
+#include <QSet>
 #include <QString>
 
 // XLibUtil is a helper class that wraps all X11 functions and
@@ -50,6 +54,25 @@
 //
 // If any X11 functions need to be added, they should be added here and the
 // X11 headers included in the cpp file in order to avoid the above issues.
+//
+// Functions that take an xcb connection only use that connection and can be
+// called from any thread. Everything else uses Qt's connection and must be
+// called from the GUI thread.
+
+struct xcb_connection_t;
+
+// A search for XLibUtil::findWindows. Looks for the window owned by pid, or
+// one of descendants, when pid isn't 0. Otherwise looks for a window
+// matching expression. A window whose _NET_STARTUP_ID is startupId matches
+// either way.
+struct XLibUtilWindowSearch
+{
+    pid_t pid;
+    MatchExpression expression;
+    bool checkNormality;
+    QSet<pid_t> descendants = {};
+    QByteArray startupId = {};
+};
 
 class XLibUtil : public QObject
 {
@@ -57,12 +80,15 @@ class XLibUtil : public QObject
 
 public:
     // Qt registered the X error handler and writes the errors to the console.
-    // This will prevent x errors from being written to the console.
+    // This replaces it with one that counts errors instead.
     //
-    // The isValidWindowId function in will generate errors if the
-    // window is not valid while it is checking. Which is the point
-    // of the function.
-    static void silenceXErrors();
+    // Functions that take an XLibUtilError return the errors their own
+    // requests cause. Windows can go away at any time so operations on
+    // them are attempted and the error is checked afterwards, instead of
+    // checking the window is valid first. Errors nobody asked for are
+    // counted in unhandledErrorCount.
+    static void installErrorHandler();
+    static quint64 unhandledErrorCount();
 
     // Helper function to allocate the size hints type.
     static XLibUtilSizeHints *newSizeHints();
@@ -74,39 +100,110 @@ public:
     static bool isNormalWindow(windowid_t window);
     static bool isValidWindowId(windowid_t window);
 
+    // Window searches look at the windows listed in the root window's
+    // _NET_CLIENT_LIST. The entire window tree is only walked if the window
+    // manager doesn't publish the list.
+    //
+    // Windows without _NET_WM_PID are found with the X-Resource extension,
+    // which knows the pid of each local client, before walking the tree.
+    // Needs X-Resource 1.2 and KDocker built with HAVE_XRES.
     static windowid_t pidToWid(bool checkNormality, pid_t epid);
-    static windowid_t findWindow(bool checkNormality, const QRegularExpression &ename,
-                                 QList<windowid_t> dockedWindows = QList<windowid_t>());
+
+    // Runs several searches in one pass. Each window's properties are read once
+    // and tested against every search. Returns the window found for each search,
+    // or 0, in the same order as searches. Windows in dockedWindows, or already
+    // found by an earlier search, aren't matched.
+    static QList<windowid_t> findWindows(const QList<XLibUtilWindowSearch> &searches,
+                                         const QList<windowid_t> &dockedWindows);
+    static QList<windowid_t> findWindows(const QList<XLibUtilWindowSearch> &searches,
+                                         const QList<windowid_t> &candidates, const QList<windowid_t> &dockedWindows);
+
+    // Reads the properties of every window in a single round trip. Only the
+    // XLibUtilWindowInfo::Field groups in fields are read.
+    static QList<XLibUtilWindowInfo> getWindowInfo(const QList<windowid_t> &windows,
+                                                   quint32 fields = XLibUtilWindowInfo::All);
+    // Tests windows against the searches that don't have a window in found yet.
+    // found must have an entry for every search. Doesn't talk to the X server.
+    static void matchWindows(const QList<XLibUtilWindowSearch> &searches, const QList<XLibUtilWindowInfo> &windows,
+                             const QList<windowid_t> &dockedWindows, QList<windowid_t> *found);
+
+    // Windows managed by the window manager (_NET_CLIENT_LIST). Returns false
+    // if the window manager doesn't publish the list.
+    static bool getClientWindows(QList<windowid_t> *clients);
+    // The window (or subwindow) with a WM_STATE. For a window manager frame this
+    // is the application window within the frame.
+    static windowid_t getClientWindow(windowid_t window);
+    static windowid_t getRootWindow();
+    // Children of the root window.
+    static QList<windowid_t> getTopLevelWindows();
 
     // Get the currently focused window.
     static windowid_t getActiveWindow();
-    // Requests user to select a window by grabbing the mouse.
-    // A left click will select the application.
-    // Clicking any other mouse button or the Escape key will abort the selection.
-    static windowid_t selectWindow(GrabInfo &grabInfo, QString &error);
+    // The window with the input focus. Used when _NET_ACTIVE_WINDOW isn't set.
+    static windowid_t getInputFocus();
+    // Grabs the mouse and the Escape key so the user can select a window.
+    // Doesn't wait for the selection. The button press and key release are
+    // delivered to the native event filter. See GrabInfo.
+    static bool grabSelection(XLibUtilGrab &grab, QString &error);
+    static void ungrabSelection(XLibUtilGrab &grab);
 
     // Have window events we care about sent to the X11 Event loop.
     // We're part of the event loop so we'll get the events.
-    static void subscribe(windowid_t window);
-    // Stop receiving events from window.
-    static void unSubscribe(windowid_t window);
+    //
+    // The subscribe functions only add to the events already being received
+    // and return the events that were added to each window. Pass the hash to
+    // unSubscribe to remove only those events.
+    static QHash<windowid_t, quint32> subscribe(windowid_t window);
+    // Have windows being created, mapped and destroyed, as well as property
+    // changes on the root window, sent to the X11 Event loop.
+    static QHash<windowid_t, quint32> subscribeNewWindows();
+    // Have property changes of the windows sent to the X11 Event loop.
+    static QHash<windowid_t, quint32> subscribeProperties(const QList<windowid_t> &windows);
+    // Stop receiving the events that were added.
+    static void unSubscribe(const QHash<windowid_t, quint32> &added);
 
     // Get the desktop the window is on.
-    static long getWindowDesktop(windowid_t window);
-    // Get the desktop the user is currently viewing.
-    static long getCurrentDesktop();
-
+    static long getWindowDesktop(windowid_t window, XLibUtilError *error = nullptr);
+    // Reads the window manager's root window properties in a single round trip.
+    static XLibUtilRootState getRootState();
+
+    // A simple call to withdrawWindow wont do. Hiding a window is done by:
+    // 1. Iconify. This will make the application hide all its other windows. For
+    //    example, xmms would take off the playlist and equalizer window.
+    // 2. Withdraw the window to remove it from the taskbar once the window
+    //    manager has iconified it.
+    // Neither waits on the X server.
     static void iconifyWindow(windowid_t window);
+    static void withdrawWindow(windowid_t window);
+    // Unmaps the window without telling the window manager it's being withdrawn.
+    static void unmapWindow(windowid_t window);
     // Is the window in an iconified state.
-    static bool isWindowIconic(windowid_t window);
+    static bool isWindowIconic(windowid_t window, XLibUtilError *error = nullptr);
     // Shows the window regardless if it's minimized or iconified.
     static void raiseWindow(windowid_t window);
 
-    static QPixmap getWindowIcon(windowid_t window);
-    static QString getAppName(windowid_t window);
-    static QString getWindowTitle(windowid_t window);
-
-    static atom_t getAtom(const char *name);
+    static QPixmap getWindowIcon(windowid_t window, XLibUtilError *error = nullptr);
+    // Only _NET_WM_ICON. WM_HINTS icons are pixmaps that need Xlib to read.
+    static QImage getWindowNetWMIcon(xcb_connection_t *connection, windowid_t window, XLibUtilError *error = nullptr);
+    static QString getAppName(windowid_t window, XLibUtilError *error = nullptr);
+    static QString getWindowTitle(windowid_t window, XLibUtilError *error = nullptr);
+    static QString getWindowTitle(xcb_connection_t *connection, windowid_t window, XLibUtilError *error = nullptr);
+
+    // The same as pidToWid and getWindowIcon without blocking. Requests go
+    // out on a separate connection and the coroutine is resumed from the
+    // event loop as the replies arrive. Any number can be in flight at once.
+    // pidToWidAsync's X-Resource step, used when no window has a matching
+    // _NET_WM_PID, still blocks: XRes only works on the Xlib connection. It's
+    // a few small requests, not a tree walk.
+    static Task<windowid_t> pidToWidAsync(bool checkNormality, pid_t pid);
+    static Task<QPixmap> getWindowIconAsync(windowid_t window);
+    // The display Qt is connected to. For opening another connection to it.
+    static QByteArray getDisplayName();
+
+    // Interns every atom in XLIBUTIL_ATOMS. Called once at startup. atoms()
+    // interns them on first use if this hasn't been called.
+    static void internAtoms();
+    static const XLibUtilAtoms &atoms();
 
     static void setWindowSkipTaskbar(windowid_t window, bool set);
     static void setWindowSkipPager(windowid_t window, bool set);
@@ -121,4 +218,22 @@ public:
     static void closeWindow(windowid_t window);
 };
 
+// Defers waiting on the X server while it's alive. XLibUtil functions
+// normally flush, and some sync, after sending their requests. Within a
+// batch the requests are queued and sent together when the outermost
+// batch ends. Ending the batch costs at most one round trip no matter how
+// many operations were done. Batches can be nested.
+//
+//   XLibUtilBatch batch;
+//   for (...)
+//       XLibUtil::iconifyWindow(window);
+class XLibUtilBatch
+{
+public:
+    XLibUtilBatch();
+    ~XLibUtilBatch();
+    XLibUtilBatch(const XLibUtilBatch &) = delete;
+    XLibUtilBatch &operator=(const XLibUtilBatch &) = delete;
+};
+
 #endif // _XLIBUTIL_H
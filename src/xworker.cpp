@@ -0,0 +1,209 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#include "xworker.h"
+#include "xlibutil.h"
+
+#include <QDebug>
+
+#include <xcb/xcb.h>
+
+// Requests and results that can be waiting at once. More requests are held
+// on the GUI thread until there's room.
+static const size_t QUEUE_SIZE = 256;
+
+static quint64 queryKey(int query, windowid_t window)
+{
+    return (static_cast<quint64>(query) << 32) | window;
+}
+
+XWorker::XWorker()
+    : m_connection(nullptr), m_thread(nullptr), m_requests(QUEUE_SIZE), m_results(QUEUE_SIZE), m_stopping(false),
+      m_broken(false), m_deliverQueued(false)
+{}
+
+XWorker::~XWorker()
+{
+    stop();
+}
+
+void XWorker::start()
+{
+    if (m_thread != nullptr)
+        return;
+
+    // Same server Qt is connected to.
+    m_connection = xcb_connect(XLibUtil::getDisplayName().constData(), nullptr);
+    if (xcb_connection_has_error(m_connection)) {
+        qWarning() << "Could not open a second connection to the X server. Properties will be read on the GUI thread";
+        xcb_disconnect(m_connection);
+        m_connection = nullptr;
+        return;
+    }
+
+    m_stopping = false;
+    m_thread = QThread::create([this] { run(); });
+    m_thread->start();
+}
+
+void XWorker::stop()
+{
+    if (m_thread == nullptr)
+        return;
+
+    m_stopping = true;
+    m_wake.release();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+
+    xcb_disconnect(m_connection);
+    m_connection = nullptr;
+    m_overflow.clear();
+    m_inFlight.clear();
+}
+
+bool XWorker::requestTitle(windowid_t window)
+{
+    return request(Query::Title, window);
+}
+
+bool XWorker::requestIcon(windowid_t window)
+{
+    return request(Query::Icon, window);
+}
+
+bool XWorker::request(Query query, windowid_t window)
+{
+    if (m_thread == nullptr || m_broken)
+        return false;
+
+    // Already being read. The value could have changed after it was read
+    // so it's read again once the current read is done.
+    auto it = m_inFlight.find(queryKey(static_cast<int>(query), window));
+    if (it != m_inFlight.end()) {
+        it.value() = true;
+        return true;
+    }
+
+    m_inFlight.insert(queryKey(static_cast<int>(query), window), false);
+    send({query, window});
+    return true;
+}
+
+void XWorker::send(const Request &request)
+{
+    // Keep the order requests were made.
+    if (!m_overflow.isEmpty() || !m_requests.push(request)) {
+        m_overflow.append(request);
+        return;
+    }
+    m_wake.release();
+}
+
+void XWorker::run()
+{
+    while (true) {
+        m_wake.acquire();
+        if (m_stopping)
+            break;
+
+        Request request;
+        if (!m_requests.pop(request))
+            continue;
+
+        if (xcb_connection_has_error(m_connection)) {
+            // Everything still waiting is dropped. New requests are read on
+            // the GUI thread.
+            m_broken = true;
+            break;
+        }
+
+        Result result;
+        result.query = request.query;
+        result.window = request.window;
+        switch (request.query) {
+            case Query::Title:
+                result.title = XLibUtil::getWindowTitle(m_connection, request.window, &result.error);
+                break;
+            case Query::Icon:
+                result.icon = XLibUtil::getWindowNetWMIcon(m_connection, request.window, &result.error);
+                break;
+        }
+        post(std::move(result));
+    }
+}
+
+void XWorker::post(Result &&result)
+{
+    // The GUI thread makes room when it takes the results.
+    while (!m_results.push(std::move(result))) {
+        if (m_stopping)
+            return;
+        QThread::msleep(1);
+    }
+
+    // One call for every result that arrives before the GUI thread gets to them.
+    if (!m_deliverQueued.exchange(true))
+        QMetaObject::invokeMethod(this, &XWorker::deliver, Qt::QueuedConnection);
+}
+
+void XWorker::deliver()
+{
+    // Cleared first so results posted from now on queue another call.
+    m_deliverQueued = false;
+
+    QList<Result> results;
+    Result result;
+    while (m_results.pop(result)) {
+        results.append(std::move(result));
+    }
+
+    // Results made room for requests that didn't fit.
+    while (!m_overflow.isEmpty() && m_requests.push(m_overflow.first())) {
+        m_overflow.removeFirst();
+        m_wake.release();
+    }
+
+    // Handlers can dock and undock windows. Done after the queues are
+    // serviced so requests they make are sent normally.
+    for (const Result &r : std::as_const(results)) {
+        bool again = m_inFlight.take(queryKey(static_cast<int>(r.query), r.window));
+        if (again && r.error != XLibUtilError::WindowError) {
+            m_inFlight.insert(queryKey(static_cast<int>(r.query), r.window), false);
+            send({r.query, r.window});
+        }
+
+        if (r.error == XLibUtilError::WindowError) {
+            emit windowError(r.window);
+            continue;
+        }
+        if (r.error != XLibUtilError::NoError)
+            continue;
+
+        switch (r.query) {
+            case Query::Title:
+                emit titleRead(r.window, r.title);
+                break;
+            case Query::Icon:
+                emit iconRead(r.window, r.icon);
+                break;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+/*
+ *  Copyright (C) 2026 KDocker contributors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307,
+ * USA.
+ */
+
+#ifndef _XWORKER_H
+#define _XWORKER_H
+
+#include "spscqueue.h"
+#include "xlibtypes.h"
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+
+struct xcb_connection_t;
+
+// Reads window properties on a thread with its own connection to the X
+// server. Large properties, such as a multi-megabyte _NET_WM_ICON, don't
+// stall Qt's event processing while they're read.
+//
+// Requests and results are passed between the threads with lock free
+// queues. Results are reported with signals on the GUI thread.
+//
+// Only reads are done on the worker. Anything that changes a window stays
+// on Qt's connection so it's ordered with everything else KDocker sends.
+class XWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    XWorker();
+    ~XWorker();
+
+    // Connects to the X server and starts the thread.
+    void start();
+    void stop();
+
+    // Returns false if the worker isn't running. The caller needs to read
+    // the property itself.
+    bool requestTitle(windowid_t window);
+    // Only _NET_WM_ICON is read. A null image is reported when the window
+    // doesn't have one.
+    bool requestIcon(windowid_t window);
+
+signals:
+    void titleRead(windowid_t window, const QString &title);
+    void iconRead(windowid_t window, const QImage &icon);
+    // The window was destroyed.
+    void windowError(windowid_t window);
+
+private:
+    enum class Query
+    {
+        Title,
+        Icon
+    };
+
+    struct Request
+    {
+        Query query = Query::Title;
+        windowid_t window = 0;
+    };
+
+    struct Result
+    {
+        Query query = Query::Title;
+        windowid_t window = 0;
+        XLibUtilError error = XLibUtilError::NoError;
+        QString title;
+        QImage icon;
+    };
+
+    bool request(Query query, windowid_t window);
+    void send(const Request &request);
+    // Worker thread.
+    void run();
+    void post(Result &&result);
+    // GUI thread.
+    void deliver();
+
+    xcb_connection_t *m_connection;
+    QThread *m_thread;
+
+    SpscQueue<Request> m_requests;
+    SpscQueue<Result> m_results;
+    // Released once for each request pushed.
+    QSemaphore m_wake;
+    std::atomic<bool> m_stopping;
+    // The connection to the X server was lost.
+    std::atomic<bool> m_broken;
+    // A call to deliver is already waiting in the event loop.
+    std::atomic<bool> m_deliverQueued;
+
+    // GUI thread only.
+    // Requests that didn't fit in the queue. Sent as results make room.
+    QList<Request> m_overflow;
+    // Queries being read. True if it was requested again in the meantime
+    // and needs to be read again once the current read is done.
+    QHash<quint64, bool> m_inFlight;
+};
+
+#endif // _XWORKER_H